@@ -29,10 +29,16 @@ struct GenericTbl {
 	uint8_t code4;
 };
 
+// lock, rep, bnd, ... are prefixes
+bool isPrefix(const GenericTbl *p)
+{
+	return p->code2 == 0 && (p->code1 == 0xF0 || p->code1 == 0xF2 || p->code1 == 0xF3);
+}
+
 void putGeneric(const GenericTbl *p, size_t n)
 {
 	for (size_t i = 0; i < n; i++) {
-		printf("void %s() { db(0x%02X); ", p->name, p->code1);
+		printf("void %s() { %sdb(0x%02X); ", p->name, isPrefix(p) ? "" : "countInsn(); ", p->code1);
 		if (p->code2) printf("db(0x%02X); ", p->code2);
 		if (p->code3) printf("db(0x%02X); ", p->code3);
 		if (p->code4) printf("db(0x%02X); ", p->code4);
@@ -824,8 +830,8 @@ void put()
 			{ "clzero", 0x0F, 0x01, 0xFC },
 		};
 		putGeneric(tbl, NUM_OF_ARRAY(tbl));
-		puts("void enter(uint16_t x, uint8_t y) { db(0xC8); dw(x); db(y); }");
-		puts("void int_(uint8_t x) { db(0xCD); db(x); }");
+		puts("void enter(uint16_t x, uint8_t y) { countInsn(); db(0xC8); dw(x); db(y); }");
+		puts("void int_(uint8_t x) { countInsn(); db(0xCD); db(x); }");
 		putLoadSeg("lss", T_0F, 0xB2);
 		putLoadSeg("lfs", T_0F, 0xB4);
 		putLoadSeg("lgs", T_0F, 0xB5);
@@ -1083,8 +1089,8 @@ void put()
 			const Tbl *p = &tbl[i];
 			putMemOp(p->name, p->type, p->ext, p->code, 32, p->fwait);
 		}
-		puts("void fstsw(const Reg16& r) { if (r.getIdx() != Operand::AX) XBYAK_THROW(ERR_BAD_PARAMETER) db(0x9B); db(0xDF); db(0xE0); }");
-		puts("void fnstsw(const Reg16& r) { if (r.getIdx() != Operand::AX) XBYAK_THROW(ERR_BAD_PARAMETER) db(0xDF); db(0xE0); }");
+		puts("void fstsw(const Reg16& r) { if (r.getIdx() != Operand::AX) XBYAK_THROW(ERR_BAD_PARAMETER) countInsn(); db(0x9B); db(0xDF); db(0xE0); }");
+		puts("void fnstsw(const Reg16& r) { if (r.getIdx() != Operand::AX) XBYAK_THROW(ERR_BAD_PARAMETER) countInsn(); db(0xDF); db(0xE0); }");
 	}
 	{
 		const struct Tbl {
@@ -1147,8 +1153,8 @@ void put()
 	// misc
 	{
 		puts("void lea(const Reg& reg, const Address& addr) { if (!reg.isBit(16 | i32e)) XBYAK_THROW(ERR_BAD_SIZE_OF_REGISTER) opMR(addr, reg, T_ALLOW_DIFF_SIZE, 0x8D); }");
-		puts("void ret(int imm = 0) { if (imm) { db(0xC2); dw(imm); } else { db(0xC3); } }");
-		puts("void retf(int imm = 0) { if (imm) { db(0xCA); dw(imm); } else { db(0xCB); } }");
+		puts("void ret(int imm = 0) { countInsn(); if (imm) { db(0xC2); dw(imm); } else { db(0xC3); } }");
+		puts("void retf(int imm = 0) { countInsn(); if (imm) { db(0xCA); dw(imm); } else { db(0xCB); } }");
 
 		puts("void xadd(const Operand& op, const Reg& reg) { opRO(reg, op, T_0F, 0xC0 | (reg.isBit(8) ? 0 : 1), op.getBit() == reg.getBit()); }");
 		puts("void cmpxchg(const Operand& op, const Reg& reg) { opRO(reg, op, T_0F, 0xB0 | (reg.isBit(8) ? 0 : 1), op.getBit() == reg.getBit()); }");
@@ -1191,8 +1197,8 @@ void put()
 		puts("void umwait(const Reg32& r) { opRR(esi, r, T_F2|T_0F, 0xAE); }");
 		puts("void clwb(const Address& addr) { opMR(addr, esi, T_66|T_0F|T_ALLOW_DIFF_SIZE, 0xAE); }");
 		puts("void cldemote(const Address& addr) { opMR(addr, eax, T_0F|T_ALLOW_DIFF_SIZE, 0x1C); }");
-		puts("void xabort(uint8_t imm) { db(0xC6); db(0xF8); db(imm); }");
-		puts("void xbegin(uint32_t rel) { db(0xC7); db(0xF8); dd(rel); }");
+		puts("void xabort(uint8_t imm) { countInsn(); db(0xC6); db(0xF8); db(imm); }");
+		puts("void xbegin(uint32_t rel) { countInsn(); db(0xC7); db(0xF8); dd(rel); }");
 
 		puts("void vsha512msg1(const Ymm& y, const Xmm& x) { if (!(y.isYMM() && x.isXMM())) XBYAK_THROW(ERR_BAD_PARAMETER) opVex(y, 0, x, T_F2 | T_0F38 | T_W0 | T_YMM, 0xCC); }");
 		puts("void vsha512msg2(const Ymm& y1, const Ymm& y2) { if (!(y1.isYMM() && y2.isYMM())) XBYAK_THROW(ERR_BAD_PARAMETER) opVex(y1, 0, y2, T_F2 | T_0F38 | T_W0 | T_YMM, 0xCD); }");
@@ -1967,7 +1973,7 @@ void put64()
 
 	puts("void vmovq(const Xmm& x, const Reg64& r) { opAVX_X_X_XM(x, xm0, r, T_66 | T_0F | T_W1 | T_EVEX | T_EW1, 0x6E); }");
 	puts("void vmovq(const Reg64& r, const Xmm& x) { opAVX_X_X_XM(x, xm0, r, T_66 | T_0F | T_W1 | T_EVEX | T_EW1, 0x7E); }");
-	puts("void jmpabs(uint64_t addr) { db(0xD5); db(0x00); db(0xA1); dq(addr); }");
+	puts("void jmpabs(uint64_t addr) { countInsn(); db(0xD5); db(0x00); db(0xA1); dq(addr); }");
 	puts("void push2(const Reg64& r1, const Reg64& r2) { opROO(r1, r2, Reg64(6), T_APX|T_ND1|T_W0, 0xFF); }");
 	puts("void push2p(const Reg64& r1, const Reg64& r2) { opROO(r1, r2, Reg64(6), T_APX|T_ND1|T_W1, 0xFF); }");
 	puts("void pop2(const Reg64& r1, const Reg64& r2) { opROO(r1, r2, Reg64(0), T_APX|T_ND1|T_W0, 0x8F); }");
@@ -2051,7 +2057,7 @@ void putAMX_MISC()
 	puts("void sttilecfg(const Address& addr) { opAMX(tmm0, addr,  T_66|T_0F38|T_W0, 0x49); }");
 	puts("void tilestored(const Address& addr, const Tmm& tm) { opAMX(tm, addr, T_F3|T_0F38|T_W0, 0x4B); }");
 
-	puts("void tilerelease() { db(0xc4); db(0xe2); db(0x78); db(0x49); db(0xc0); }");
+	puts("void tilerelease() { countInsn(); db(0xc4); db(0xe2); db(0x78); db(0x49); db(0xc0); }");
 	puts("void tilezero(const Tmm& t) { opVex(t, &tmm0, tmm0, T_F2|T_0F38|T_W0, 0x49); }");
 
 //	puts("void tconjtfp16(const Tmm& t1, const Tmm& t2) { opVex(t1, 0, t2, T_66|T_0F38|T_W0, 0x6B); }");
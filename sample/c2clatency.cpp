@@ -0,0 +1,206 @@
+/*
+	core-to-core latency of a cache line ping-pong between every pair of logical CPUs
+
+	make c2clatency
+	./c2clatency [cpus] [n]
+	cpus ; the logical CPU indices of CpuTopology to measure such as "0-7,16" (all CPUs by default)
+	       the CPUs out of the affinity of the process (taskset, cpuset) are skipped
+	n ; the number of round trips of a measurement (10000 by default)
+
+	two threads pinned to CPU a and b write a counter in a shared cache line by turns.
+	the spin loops are generated by Xbyak.
+	the one-way latency (half of a round trip) is printed as a matrix
+	and summarized by the relation of the CPUs (SMT sibling, shared L2, shared L3, same NUMA node, and others).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <xbyak/xbyak_util.h>
+
+using namespace Xbyak;
+using namespace Xbyak::util;
+
+/*
+	void f(uint64_t *flag, uint64_t v, size_t n)
+	for (i = 0; i < n; i++) {
+		while (*flag != v) {}
+		*flag = v + 1;
+		v += 2;
+	}
+*/
+struct PingPong : CodeGenerator {
+	PingPong()
+	{
+		const Reg64& flag = rdi;
+		const Reg64& v = rsi;
+		const Reg64& n = rdx;
+#ifdef XBYAK64_WIN
+		push(rdi);
+		push(rsi);
+		mov(flag, rcx);
+		mov(v, rdx);
+		mov(n, r8);
+#endif
+		Label lp, wait;
+		align(16);
+		L(lp);
+		L(wait);
+		cmp(ptr[flag], v);
+		jne(wait); // pause is not used because it takes a long time on some CPUs
+		lea(rax, ptr[v + 1]);
+		mov(ptr[flag], rax);
+		add(v, 2);
+		dec(n);
+		jnz(lp);
+#ifdef XBYAK64_WIN
+		pop(rsi);
+		pop(rdi);
+#endif
+		ret();
+	}
+};
+
+enum Relation {
+	SMT,
+	SameL2,
+	SameL3,
+	SameNode,
+	Other,
+	RelationNum
+};
+
+static const char *getRelationStr(int r)
+{
+	static const char *tbl[] = { "SMT sibling", "shared L2", "shared L3", "same node", "other" };
+	return tbl[r];
+}
+
+static Relation getRelation(const CpuTopology& topo, uint32_t a, uint32_t b)
+{
+	const LogicalCpu& cpu = topo.getLogicalCpu(a);
+	const CacheType tbl[] = { L1d, L2, L3 };
+	for (int i = 0; i < 3; i++) {
+		if (cpu.cache[tbl[i]].sharedCpuIndices.contains(b)) return Relation(i);
+	}
+	if (cpu.nodeIdx == topo.getLogicalCpu(b).nodeIdx) return SameNode;
+	return Other;
+}
+
+static bool pin(uint32_t cpuIdx)
+{
+	CpuMask m;
+	return m.append(cpuIdx) && setAffinity(m);
+}
+
+// one-way latency in nsec between CPU a and b (negative if the threads can't be pinned)
+static double measure(void (*f)(uint64_t*, uint64_t, size_t), uint32_t a, uint32_t b, size_t n)
+{
+	if (!pin(a)) return -1;
+	// the line is not shared with other data
+	uint64_t *flag = (uint64_t*)AlignedMalloc(128, 128);
+	double best = -1;
+	const int trialN = 5;
+	for (int i = 0; i < trialN; i++) {
+		*flag = 0;
+		std::atomic<int> state(0); // 1 if pinned, 2 if failed
+		std::thread t([&]() {
+			state = pin(b) ? 1 : 2;
+			if (state == 1) f(flag, 1, n);
+		});
+		while (state == 0) std::this_thread::yield();
+		if (state == 2) {
+			t.join();
+			best = -1;
+			break;
+		}
+		const uint64_t c0 = Clock::getRdtscBegin();
+		f(flag, 0, n);
+		const uint64_t c1 = Clock::getRdtscEnd();
+		t.join();
+		const double ns = Clock::toNs(c1 - c0) / (n * 2);
+		if (best < 0 || ns < best) best = ns;
+	}
+	AlignedFree(flag);
+	return best;
+}
+
+int main(int argc, char *argv[])
+{
+	CpuTopology topo(Cpu::getInstance());
+	const uint32_t logicalCpuNum = uint32_t(topo.getLogicalCpuNum());
+	CpuMask cpus;
+	if (argc > 1) {
+		if (!cpus.setStr(argv[1])) {
+			printf("bad cpus %s\n", argv[1]);
+			return 1;
+		}
+		// reject the indices which are not logical CPUs of the topology
+		for (CpuMask::const_iterator it = cpus.begin(); it != cpus.end(); ++it) {
+			if (*it >= logicalCpuNum) {
+				printf("cpu %u is not in the topology (%u logical CPUs)\n", *it, logicalCpuNum);
+				return 1;
+			}
+		}
+	}
+	const size_t n = argc > 2 ? size_t(atoi(argv[2])) : 10000;
+	// the CPUs allowed by taskset or cpuset (all CPUs if they are unknown)
+	CpuMask org;
+	const bool hasAffinity = getAffinity(org);
+	// the logical CPUs of the topology selected by cpus (all of them by default) where the process can run
+	std::vector<uint32_t> v;
+	for (uint32_t i = 0; i < logicalCpuNum; i++) {
+		if (argc > 1 && !cpus.contains(i)) continue;
+		if (hasAffinity && !org.contains(i)) continue;
+		v.push_back(i);
+	}
+	if (v.size() < 2 || n == 0) {
+		printf("at least two allowed CPUs and n > 0 are necessary\n");
+		return 1;
+	}
+	PingPong code;
+	void (*f)(uint64_t*, uint64_t, size_t) = code.getCode<void (*)(uint64_t*, uint64_t, size_t)>();
+
+	const size_t cpuN = v.size();
+	std::vector<double> mat(cpuN * cpuN, 0);
+	double sum[RelationNum] = {}, minTbl[RelationNum] = {}, maxTbl[RelationNum] = {};
+	int cnt[RelationNum] = {};
+	for (size_t i = 0; i < cpuN; i++) {
+		for (size_t j = i + 1; j < cpuN; j++) {
+			const double ns = measure(f, v[i], v[j], n);
+			if (ns < 0) {
+				printf("can't pin the threads to %u and %u\n", v[i], v[j]);
+				return 1;
+			}
+			mat[i * cpuN + j] = mat[j * cpuN + i] = ns;
+			const Relation r = getRelation(topo, v[i], v[j]);
+			if (cnt[r] == 0 || ns < minTbl[r]) minTbl[r] = ns;
+			if (cnt[r] == 0 || ns > maxTbl[r]) maxTbl[r] = ns;
+			sum[r] += ns;
+			cnt[r]++;
+		}
+	}
+	if (hasAffinity) setAffinity(org);
+
+	printf("one-way latency (nsec)\n");
+	printf("%5s", "");
+	for (size_t j = 0; j < cpuN; j++) printf(" %6u", v[j]);
+	printf("\n");
+	for (size_t i = 0; i < cpuN; i++) {
+		printf("%5u", v[i]);
+		for (size_t j = 0; j < cpuN; j++) {
+			if (i == j) {
+				printf(" %6s", "-");
+			} else {
+				printf(" %6.1f", mat[i * cpuN + j]);
+			}
+		}
+		printf("\n");
+	}
+	printf("\n%-12s %6s %8s %8s %8s\n", "relation", "pairs", "min", "mean", "max");
+	for (int r = 0; r < RelationNum; r++) {
+		if (cnt[r] == 0) continue;
+		printf("%-12s %6d %8.1f %8.1f %8.1f\n", getRelationStr(r), cnt[r], minTbl[r], sum[r] / cnt[r], maxTbl[r]);
+	}
+}
@@ -27,6 +27,11 @@ void printSystemTopology(const CpuTopology& cpuTopo)
 	printf("  Physical Cores: %zu\n", cpuTopo.getPhysicalCoreNum());
 	printf("  Cache Line Size:%u bytes\n", cpuTopo.getLineSize());
 	printf("  Hybrid System:  %s\n", cpuTopo.isHybrid() ? "Yes (P-cores + E-cores)" : "No");
+	printf("  NUMA Nodes:     %zu\n", cpuTopo.getNodeNum());
+	for (size_t i = 0; i < cpuTopo.getNodeNum(); i++) {
+		printf("    ");
+		cpuTopo.getNode(i).put();
+	}
 	printf("\n");
 }
 
@@ -42,7 +47,7 @@ void printLogicalCpuDetails(const CpuTopology& cpuTopo)
 
 	for (size_t i = 0; i < numCpus && i < maxCpusToPrint; i++) {
 		const LogicalCpu& logCpu = cpuTopo.getLogicalCpu(i);
-		printf("  CPU %3zu: Core=%u Type=%s Siblings=", i, logCpu.coreId, getCoreTypeStr(logCpu.coreType));
+		printf("  CPU %3zu: Core=%u Type=%s Node=%u Siblings=", i, logCpu.coreId, getCoreTypeStr(logCpu.coreType), logCpu.nodeIdx);
 		logCpu.getSiblings().put();
 	}
 
@@ -206,6 +211,18 @@ void printSmallSample(const CpuTopology& cpuTopo)
 	}
 }
 
+void printThreadPlacement(const CpuTopology& cpuTopo)
+{
+	printSeparator();
+	printf("partitionWork - 1000 items on all CPUs\n");
+	printSeparator();
+	const std::vector<WorkRange> v = partitionWork(cpuTopo, 1000);
+	for (size_t i = 0; i < v.size(); i++) {
+		printf("  thread %3zu: CPU %3u [%zu, %zu)\n", i, v[i].cpuIdx, v[i].begin, v[i].end);
+	}
+	printf("\n");
+}
+
 int main()
 	try
 {
@@ -223,6 +240,7 @@ int main()
 	printLogicalCpuDetails(cpuTopo);
 	printCacheHierarchy(cpuTopo, group);
 	printCacheSharingDetails(cpuTopo, group);
+	printThreadPlacement(cpuTopo);
 
 	printSeparator();
 	printf("All tests completed successfully!\n");
@@ -0,0 +1,60 @@
+/*
+	benchmark of the construction and destruction of CodeGenerator
+
+	make gen_bench gen_bench_old
+	./gen_bench      ; registers are static constexpr members (default on C++14 or later)
+	./gen_bench_old  ; registers are non-static members (-DXBYAK_NO_CONSTEXPR_REGISTERS)
+*/
+#include <stdio.h>
+#include <xbyak/xbyak_util.h>
+
+MIE_ALIGN(4096) static uint8_t buf[4096];
+
+struct Code : Xbyak::CodeGenerator {
+	explicit Code(void *userPtr = 0)
+		: Xbyak::CodeGenerator(sizeof(buf), userPtr)
+	{
+		mov(eax, 1);
+		add(eax, ecx);
+		ret();
+	}
+};
+
+template<class F>
+void bench(const char *msg, F f, int n)
+{
+	Xbyak::util::Clock clk;
+	clk.begin();
+	for (int i = 0; i < n; i++) f();
+	clk.end();
+	printf("%-16s %8.2f clk\n", msg, clk.getClock() / double(n));
+}
+
+static void genUserBuf()
+{
+	Code c(buf);
+}
+
+static void genAlloc()
+{
+	Code c;
+}
+
+static void genNoInstr()
+{
+	Xbyak::CodeGenerator c(sizeof(buf), buf);
+}
+
+int main()
+{
+#ifdef XBYAK_USE_CONSTEXPR_REGISTERS
+	puts("registers: static constexpr");
+#else
+	puts("registers: non-static members");
+#endif
+	printf("sizeof(CodeGenerator)=%zu\n", sizeof(Xbyak::CodeGenerator));
+	// user buffer does not call mmap/mprotect
+	bench("empty(userBuf)", genNoInstr, 100000);
+	bench("code(userBuf)", genUserBuf, 100000);
+	bench("code(alloc)", genAlloc, 10000);
+}
@@ -0,0 +1,285 @@
+/*
+	measure the latency and bandwidth of each level of the memory hierarchy
+	with kernels generated by Xbyak
+
+	make memprobe
+	./memprobe [-csv] [maxMiB]
+
+	latency ; pointer chasing (mov rax, [rax]) on a random cyclic list of cache lines
+	read/write/copy ; streaming loads/stores with zmm (AVX-512) or ymm (AVX)
+	copy uses two buffers of size/2 and its bandwidth counts both the loaded and stored bytes
+
+	the result is printed as a table whose rows are working-set sizes
+	size(KiB) level lat(ns) lat(clk) read(GB/s) write(GB/s) copy(GB/s)
+	where level is the smallest data cache which the working set fits in (L1, L2, L3, ..., or mem)
+	-csv prints the rows as CSV with the size in bytes for tools such as blocking heuristics
+	size,level,lat_ns,lat_clk,read_gbps,write_gbps,copy_gbps
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <xbyak/xbyak_util.h>
+
+using namespace Xbyak;
+using namespace Xbyak::util;
+
+const size_t lineSize = 64;
+
+// zmm if AVX-512 is available, otherwise ymm
+static int getVecSize()
+{
+	return Cpu::getInstance().has(Cpu::tAVX512F) ? 64 : 32;
+}
+
+// void *f(void *p, size_t n) ; p = *p repeated n * unrollN times
+struct LatencyCode : CodeGenerator {
+	static const int unrollN = 16;
+	LatencyCode()
+	{
+		const Reg64& p = rax;
+		const Reg64& n = rdx;
+#ifdef XBYAK64_WIN
+		mov(p, rcx);
+#else
+		mov(p, rdi);
+		mov(n, rsi);
+#endif
+		align(16);
+		Label lp;
+		L(lp);
+		for (int i = 0; i < unrollN; i++) mov(p, ptr[p]);
+		dec(n);
+		jnz(lp);
+		ret();
+	}
+};
+
+/*
+	void f(void *dst, const void *src, size_t size, size_t rep)
+	size is a multiple of unrollN * vector size
+*/
+struct StreamCode : CodeGenerator {
+	enum Mode {
+		Read,
+		Write,
+		Copy
+	};
+	static const int unrollN = 4;
+	int vecSize_;
+	StreamCode(Mode mode, int vecSize)
+		: vecSize_(vecSize)
+	{
+#ifdef XBYAK64_WIN
+		const Reg64& dst = rcx;
+		const Reg64& src = rdx;
+		const Reg64& size = r8;
+		const Reg64& rep = r9;
+#else
+		const Reg64& dst = rdi;
+		const Reg64& src = rsi;
+		const Reg64& size = rdx;
+		const Reg64& rep = rcx;
+#endif
+		const Reg64& i = rax;
+		const Reg64& d = r10;
+		const Reg64& s = r11;
+		Label repL, lp;
+		if (mode == Write) vxorps(Ymm(0), Ymm(0), Ymm(0));
+		L(repL);
+		xor_(i, i);
+		mov(d, dst);
+		mov(s, src);
+		align(16);
+		L(lp);
+		for (int j = 0; j < unrollN; j++) {
+			const Address a = ptr[s + j * vecSize];
+			const Address b = ptr[d + j * vecSize];
+			if (mode == Read) {
+				load(j, a);
+			} else if (mode == Write) {
+				store(b, 0);
+			} else {
+				load(j, a);
+				store(b, j);
+			}
+		}
+		add(s, unrollN * vecSize);
+		add(d, unrollN * vecSize);
+		add(i, unrollN * vecSize);
+		cmp(i, size);
+		jb(lp);
+		dec(rep);
+		jnz(repL);
+		vzeroupper();
+		ret();
+	}
+	void load(int idx, const Address& a)
+	{
+		if (vecSize_ == 64) {
+			vmovaps(Zmm(idx), a);
+		} else {
+			vmovaps(Ymm(idx), a);
+		}
+	}
+	void store(const Address& a, int idx)
+	{
+		if (vecSize_ == 64) {
+			vmovaps(a, Zmm(idx));
+		} else {
+			vmovaps(a, Ymm(idx));
+		}
+	}
+};
+
+struct Row {
+	size_t size; // bytes
+	int level; // the smallest data cache which the working set fits in (0:L1, 1:L2, ..., -1:mem)
+	double latNs;
+	double latClk;
+	double readGBps;
+	double writeGBps;
+	double copyGBps;
+};
+
+// make a random cyclic list of the cache lines in [p, p + size)
+static void initList(uint8_t *p, size_t size)
+{
+	const size_t n = size / lineSize;
+	std::vector<size_t> idx(n);
+	for (size_t i = 0; i < n; i++) idx[i] = i;
+	srand(0);
+	for (size_t i = n - 1; i > 0; i--) {
+		std::swap(idx[i], idx[rand() % (i + 1)]);
+	}
+	for (size_t i = 0; i < n; i++) {
+		*(void**)(p + idx[i] * lineSize) = p + idx[(i + 1) % n] * lineSize;
+	}
+}
+
+// the minimum TSC of f() for a few trials
+template<class F>
+uint64_t measure(const F& f)
+{
+	uint64_t best = 0;
+	for (int i = 0; i < 5; i++) {
+		const uint64_t t = Clock::getRdtscBegin();
+		f();
+		const uint64_t d = Clock::getRdtscEnd() - t;
+		if (i == 0 || d < best) best = d;
+	}
+	return best;
+}
+
+static std::vector<Row> probe(size_t maxSize)
+{
+	const Cpu& cpu = Cpu::getInstance();
+	const int vecSize = getVecSize();
+	LatencyCode latCode;
+	StreamCode readCode(StreamCode::Read, vecSize);
+	StreamCode writeCode(StreamCode::Write, vecSize);
+	StreamCode copyCode(StreamCode::Copy, vecSize);
+	void *(*lat)(void *, size_t) = latCode.getCode<void *(*)(void *, size_t)>();
+	void (*read)(void *, const void *, size_t, size_t) = readCode.getCode<void (*)(void *, const void *, size_t, size_t)>();
+	void (*write)(void *, const void *, size_t, size_t) = writeCode.getCode<void (*)(void *, const void *, size_t, size_t)>();
+	void (*copy)(void *, const void *, size_t, size_t) = copyCode.getCode<void (*)(void *, const void *, size_t, size_t)>();
+
+	uint8_t *src = (uint8_t*)AlignedMalloc(maxSize, 4096);
+	uint8_t *dst = (uint8_t*)AlignedMalloc(maxSize, 4096);
+	memset(src, 1, maxSize);
+	memset(dst, 2, maxSize);
+	std::vector<Row> tbl;
+	const size_t totalBytes = size_t(64) << 20; // bytes accessed by a measurement
+	const size_t minSize = 4096;
+	for (size_t size = minSize; size <= maxSize; size *= 2) {
+		// size and size * 1.5
+		for (int k = 0; k < 2; k++) {
+			const size_t sz = k == 0 ? size : size + size / 2;
+			if (sz > maxSize) break;
+			Row r;
+			r.size = sz;
+			r.level = -1;
+			for (uint32_t i = 0; i < cpu.getDataCacheLevels(); i++) {
+				if (sz <= cpu.getDataCacheSize(i)) {
+					r.level = int(i);
+					break;
+				}
+			}
+			initList(src, sz);
+			const size_t lineN = sz / lineSize;
+			const size_t latN = (std::max)(lineN, size_t(1) << 16) / LatencyCode::unrollN;
+			void *p = src;
+			const uint64_t latClk = measure([&]() { p = lat(p, latN); });
+			if (p == 0) printf("err\n"); // use p
+			r.latClk = double(latClk) / (latN * LatencyCode::unrollN);
+			r.latNs = Clock::toNs(latClk) / (latN * LatencyCode::unrollN);
+			const size_t rep = (std::max)(totalBytes / sz, size_t(1));
+			const double bytes = double(sz) * rep;
+			r.readGBps = bytes / Clock::toNs(measure([&]() { read(dst, src, sz, rep); }));
+			r.writeGBps = bytes / Clock::toNs(measure([&]() { write(dst, src, sz, rep); }));
+			// the working set of copy is src and dst of sz / 2 each
+			r.copyGBps = bytes / Clock::toNs(measure([&]() { copy(dst, src, sz / 2, rep); }));
+			tbl.push_back(r);
+		}
+	}
+	AlignedFree(dst);
+	AlignedFree(src);
+	return tbl;
+}
+
+int main(int argc, char *argv[])
+{
+	const Cpu& cpu = Cpu::getInstance();
+	if (!cpu.has(Cpu::tAVX)) {
+		printf("AVX is necessary\n");
+		return 1;
+	}
+	bool csv = false;
+	size_t maxSize = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-csv") == 0) {
+			csv = true;
+		} else {
+			maxSize = size_t(atoi(argv[i])) << 20;
+		}
+	}
+	if (maxSize == 0) {
+		// twice the last level cache
+		const uint32_t n = cpu.getDataCacheLevels();
+		maxSize = n > 0 ? size_t(cpu.getDataCacheSize(n - 1)) * 2 : size_t(64) << 20;
+	}
+#if XBYAK_CPU_CACHE == 1
+	CpuMask org, m;
+	if (getAffinity(org) && !org.empty()) {
+		m.append(*org.begin());
+		setAffinity(m);
+	}
+#endif
+	try {
+		if (!csv) printf("TSC %.3f GHz, vector %d bytes\n", Clock::getTscHz() * 1e-9, getVecSize());
+		const std::vector<Row> tbl = probe(maxSize);
+		if (csv) {
+			printf("size,level,lat_ns,lat_clk,read_gbps,write_gbps,copy_gbps\n");
+		} else {
+			printf("%10s %5s %8s %8s %10s %10s %10s\n", "size(KiB)", "level", "lat(ns)", "lat(clk)", "read(GB/s)", "write(GB/s)", "copy(GB/s)");
+		}
+		for (size_t i = 0; i < tbl.size(); i++) {
+			const Row& r = tbl[i];
+			char level[16];
+			if (r.level < 0) {
+				snprintf(level, sizeof(level), "mem");
+			} else {
+				snprintf(level, sizeof(level), "L%d", r.level + 1);
+			}
+			if (csv) {
+				printf("%zu,%s,%.3f,%.3f,%.3f,%.3f,%.3f\n", r.size, level, r.latNs, r.latClk, r.readGBps, r.writeGBps, r.copyGBps);
+			} else {
+				printf("%10zu %5s %8.2f %8.2f %10.2f %10.2f %10.2f\n", r.size / 1024, level, r.latNs, r.latClk, r.readGBps, r.writeGBps, r.copyGBps);
+			}
+		}
+	} catch (std::exception& e) {
+		printf("ERR %s\n", e.what());
+		return 1;
+	}
+}
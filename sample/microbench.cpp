@@ -0,0 +1,54 @@
+/*
+	latency and throughput of instructions by Xbyak::util::Microbench
+
+	make microbench
+	./microbench [cpu]  ; pin the thread to cpu if given
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <xbyak/xbyak_util.h>
+
+using namespace Xbyak;
+using namespace Xbyak::util;
+
+// registers except rsp and Microbench::getCounterReg()
+static Reg64 gpr(int idx)
+{
+	static const int tbl[] = { Operand::RAX, Operand::RCX, Operand::RDX, Operand::RBX, Operand::RSI, Operand::RDI, Operand::R8, Operand::R9 };
+	return Reg64(tbl[idx]);
+}
+
+struct Bench {
+	const char *name;
+	Microbench::Body body;
+};
+
+int main(int argc, char *argv[])
+{
+	const Cpu& cpu = Cpu::getInstance();
+	Microbench mb;
+	mb.setUnroll(8); // throughput mode uses 8 independent registers
+	if (argc > 1) mb.setCpu(atoi(argv[1]));
+	// xmm/ymm/zmm14 and 15 are zero (see Microbench::Body)
+	std::vector<Bench> v;
+	v.push_back(Bench{ "add r64, r64", [](CodeGenerator& c, int i) { c.add(gpr(i), gpr(i)); } });
+	v.push_back(Bench{ "imul r64, r64", [](CodeGenerator& c, int i) { c.imul(gpr(i), gpr(i)); } });
+	v.push_back(Bench{ "addps xmm, xmm", [](CodeGenerator& c, int i) { c.addps(Xmm(i), c.xmm15); } });
+	v.push_back(Bench{ "mulps xmm, xmm", [](CodeGenerator& c, int i) { c.mulps(Xmm(i), c.xmm15); } });
+	if (cpu.has(Cpu::tAVX2 | Cpu::tFMA)) {
+		v.push_back(Bench{ "vfmadd231ps ymm", [](CodeGenerator& c, int i) { c.vfmadd231ps(Ymm(i), c.ymm14, c.ymm15); } });
+		v.push_back(Bench{ "vpermps ymm", [](CodeGenerator& c, int i) { c.vpermps(Ymm(i), c.ymm14, Ymm(i)); } });
+	}
+	if (cpu.has(Cpu::tAVX512F)) {
+		v.push_back(Bench{ "vfmadd231ps zmm", [](CodeGenerator& c, int i) { c.vfmadd231ps(Zmm(i), c.zmm14, c.zmm15); } });
+	}
+	printf("%-18s %16s %16s\n", "", "latency", "throughput");
+	for (size_t i = 0; i < v.size(); i++) {
+		Microbench::Result lat, tp;
+		if (!mb.measure(lat, v[i].body, Microbench::Latency) || !mb.measure(tp, v[i].body, Microbench::Throughput)) {
+			printf("can't pin the thread\n");
+			return 1;
+		}
+		printf("%-18s %8.2f(+-%.2f) %8.2f(+-%.2f) %s\n", v[i].name, lat.mean, lat.stddev, tp.mean, tp.stddev, lat.byPmu ? "cycle" : "TSC");
+	}
+}
@@ -1,9 +1,13 @@
 //#define XBYAK_CPUMASK_COMPACT 0
 #define XBYAK_NO_EXCEPTION
-#define XBYAK_CPUMASK_N 8
-#define XBYAK_CPUMASK_BITN 3
+#ifndef XBYAK_CPUMASK_COMPACT
+	#define XBYAK_CPUMASK_N 8
+	#define XBYAK_CPUMASK_BITN 3
+#endif
 #include <xbyak/xbyak_util.h>
 #include <cybozu/test.hpp>
+#include <set>
+#include <stdlib.h>
 
 using namespace Xbyak::util;
 
@@ -71,7 +75,9 @@ CYBOZU_TEST_AUTO(errStr)
 		"1,,",
 		"-8",
 		"3-",
+#if XBYAK_CPUMASK_BITN == 3
 		"0-8",
+#endif
 		"0--2",
 		"2-0",
 		"2,1",
@@ -90,7 +96,7 @@ CYBOZU_TEST_AUTO(errStr)
 
 CYBOZU_TEST_AUTO(pattern)
 {
-	const uint32_t bitN = XBYAK_CPUMASK_BITN;
+	const uint32_t bitN = XBYAK_CPUMASK_BITN < 3 ? XBYAK_CPUMASK_BITN : 3;
 	const uint32_t bit = 1 << bitN;
 	for (uint32_t i = 0; i < (1 << bit); i++) {
 		CpuMask m;
@@ -122,3 +128,120 @@ CYBOZU_TEST_AUTO(pattern)
 		CYBOZU_TEST_EQUAL(mstr, m2.getStr());
 	}
 }
+
+CYBOZU_TEST_AUTO(setOp)
+{
+	CpuMask a, b;
+	CYBOZU_TEST_ASSERT(a.setStr("0-3,6"));
+	CYBOZU_TEST_ASSERT(b.setStr("1-2,4-6"));
+	CYBOZU_TEST_ASSERT(a.contains(0));
+	CYBOZU_TEST_ASSERT(a.contains(6));
+	CYBOZU_TEST_ASSERT(!a.contains(4));
+	CYBOZU_TEST_ASSERT(!a.contains(7));
+	CYBOZU_TEST_ASSERT(a.intersects(b));
+	CYBOZU_TEST_EQUAL((a & b).getStr(), "1-2,6");
+	CYBOZU_TEST_EQUAL((a | b).getStr(), "0-6");
+	CYBOZU_TEST_EQUAL((a - b).getStr(), "0,3");
+	CYBOZU_TEST_EQUAL((b - a).getStr(), "4-5");
+	CpuMask c;
+	CYBOZU_TEST_ASSERT(c.setStr("5,7"));
+	CYBOZU_TEST_ASSERT(!c.intersects(a - b - c));
+	CYBOZU_TEST_ASSERT((c & CpuMask()).empty());
+	CYBOZU_TEST_ASSERT((c | CpuMask()) == c);
+	c &= b;
+	CYBOZU_TEST_EQUAL(c.getStr(), "5");
+	c |= a;
+	CYBOZU_TEST_EQUAL(c.getStr(), "0-3,5-6");
+	c -= a;
+	CYBOZU_TEST_EQUAL(c.getStr(), "5");
+}
+
+#if XBYAK_CPUMASK_COMPACT == 0
+CYBOZU_TEST_AUTO(large)
+{
+	CpuMask m;
+	CYBOZU_TEST_ASSERT(m.append(0));
+	CYBOZU_TEST_ASSERT(m.appendRange(60, 200));
+	CYBOZU_TEST_ASSERT(!m.appendRange(100, 300));
+	CYBOZU_TEST_ASSERT(m.appendRange(255, 256));
+	CYBOZU_TEST_ASSERT(m.append(4000));
+	CYBOZU_TEST_ASSERT(!m.append(4000));
+	CYBOZU_TEST_EQUAL(m.size(), 1u + 141 + 2 + 1);
+	CYBOZU_TEST_EQUAL(m.getStr(), "0,60-200,255-256,4000");
+	CYBOZU_TEST_EQUAL(m.get(0), 0u);
+	CYBOZU_TEST_EQUAL(m.get(1), 60u);
+	CYBOZU_TEST_EQUAL(m.get(141), 200u);
+	CYBOZU_TEST_EQUAL(m.get(142), 255u);
+	CYBOZU_TEST_EQUAL(m.get(144), 4000u);
+	CYBOZU_TEST_ASSERT(m.contains(128));
+	CYBOZU_TEST_ASSERT(!m.contains(201));
+	CYBOZU_TEST_ASSERT(!m.contains(5000));
+	CpuMask m2;
+	CYBOZU_TEST_ASSERT(m2.setStr(m.getStr()));
+	CYBOZU_TEST_ASSERT(m == m2);
+	CYBOZU_TEST_ASSERT(!m.append(1u << XBYAK_CPUMASK_BITN));
+
+	CpuMask odd;
+	for (uint32_t i = 1; i < 4096; i += 2) CYBOZU_TEST_ASSERT(odd.append(i));
+	CYBOZU_TEST_EQUAL((m & odd).getStr(), "61,63,65,67,69,71,73,75,77,79,81,83,85,87,89,91,93,95,97,99,101,103,105,107,109,111,113,115,117,119,121,123,125,127,129,131,133,135,137,139,141,143,145,147,149,151,153,155,157,159,161,163,165,167,169,171,173,175,177,179,181,183,185,187,189,191,193,195,197,199,255");
+	CYBOZU_TEST_EQUAL((m | odd).size(), 145u + 2048 - 71);
+	CYBOZU_TEST_EQUAL((m - odd).size(), 145u - 71);
+	// the upper words become empty
+	CpuMask low;
+	CYBOZU_TEST_ASSERT(low.appendRange(0, 3));
+	CYBOZU_TEST_EQUAL((m & low).getWordNum(), 1u);
+	CYBOZU_TEST_ASSERT((m & low) == (low & m));
+}
+
+// compare with the order of std::set
+CYBOZU_TEST_AUTO(order)
+{
+	srand(1);
+	const int n = 64;
+	std::vector<CpuMask> mv(n);
+	std::vector<std::set<uint32_t> > sv(n);
+	for (int i = 0; i < n; i++) {
+		uint32_t v = 0;
+		const int len = rand() % 5;
+		for (int j = 0; j < len; j++) {
+			v += 1 + rand() % 100;
+			CYBOZU_TEST_ASSERT(mv[i].append(v));
+			sv[i].insert(v);
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			CYBOZU_TEST_EQUAL(mv[i] < mv[j], sv[i] < sv[j]);
+			CYBOZU_TEST_EQUAL(mv[i] == mv[j], sv[i] == sv[j]);
+		}
+	}
+}
+
+#ifdef __linux__
+CYBOZU_TEST_AUTO(cpuSet)
+{
+	CpuMask m;
+	CYBOZU_TEST_ASSERT(m.setStr("1,3-5,1000,2048-2050"));
+	const size_t n = 4096;
+	cpu_set_t *set = CPU_ALLOC(n);
+	const size_t size = CPU_ALLOC_SIZE(n);
+	CYBOZU_TEST_ASSERT(toCpuSet(set, size, m));
+	CYBOZU_TEST_EQUAL(CPU_COUNT_S(size, set), 8);
+	CYBOZU_TEST_ASSERT(CPU_ISSET_S(1000, size, set));
+	CYBOZU_TEST_ASSERT(CPU_ISSET_S(2050, size, set));
+	CpuMask m2;
+	CYBOZU_TEST_ASSERT(fromCpuSet(m2, set, size));
+	CYBOZU_TEST_ASSERT(m == m2);
+	CPU_FREE(set);
+
+	// too small set
+	cpu_set_t small;
+	CYBOZU_TEST_ASSERT(!toCpuSet(&small, sizeof(small), m));
+	m2.clear();
+	CYBOZU_TEST_ASSERT(m2.setStr("0,1023"));
+	CYBOZU_TEST_ASSERT(toCpuSet(&small, sizeof(small), m2));
+	CYBOZU_TEST_ASSERT(fromCpuSet(m, &small, sizeof(small)));
+	CYBOZU_TEST_EQUAL(m.getStr(), "0,1023");
+}
+#endif
+#endif
@@ -0,0 +1,489 @@
+#include <xbyak/xbyak_util.h>
+#include <cybozu/test.hpp>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <unistd.h>
+
+using namespace Xbyak::util;
+
+#ifdef __linux__
+
+/*
+	make a fake sysfs tree
+*/
+struct Sysfs {
+	std::string root;
+	Sysfs()
+	{
+		char buf[] = "/tmp/xbyak_sysfs_XXXXXX";
+		const char *p = mkdtemp(buf);
+		if (p) root = p;
+	}
+	~Sysfs()
+	{
+		if (!root.empty()) {
+			std::string cmd = "rm -rf " + root;
+			if (system(cmd.c_str())) {}
+		}
+	}
+	void put(const std::string& name, const std::string& str) const
+	{
+		std::string path = root;
+		size_t pos = 0;
+		for (;;) {
+			size_t next = name.find('/', pos);
+			if (next == std::string::npos) break;
+			path = root + "/" + name.substr(0, next);
+			mkdir(path.c_str(), 0755);
+			pos = next + 1;
+		}
+		path = root + "/" + name;
+		FILE *fp = fopen(path.c_str(), "w");
+		if (fp) {
+			fprintf(fp, "%s\n", str.c_str());
+			fclose(fp);
+		}
+	}
+	void putCache(int cpu, int idx, const char *type, int level, const char *size, int ways, const char *shared) const
+	{
+		char dir[128];
+		snprintf(dir, sizeof(dir), "devices/system/cpu/cpu%d/cache/index%d/", cpu, idx);
+		const std::string d = dir;
+		char buf[16];
+		put(d + "type", type);
+		snprintf(buf, sizeof(buf), "%d", level);
+		put(d + "level", buf);
+		put(d + "size", size);
+		snprintf(buf, sizeof(buf), "%d", ways);
+		put(d + "ways_of_associativity", buf);
+		put(d + "shared_cpu_list", shared);
+		put(d + "coherency_line_size", "64");
+	}
+};
+
+/*
+	cpu 0-3 : P-core (SMT) ; core 0 = {0, 1}, core 1 = {2, 3}
+	cpu 4-7 : E-core ; L2 is shared by 4-7
+	L3 is shared by all
+*/
+static void makeHybrid(const Sysfs& fs)
+{
+	fs.put("devices/system/cpu/online", "0-7");
+	fs.put("devices/cpu_core/cpus", "0-3");
+	fs.put("devices/cpu_atom/cpus", "4-7");
+	for (int cpu = 0; cpu < 8; cpu++) {
+		char buf[64];
+		const bool isP = cpu < 4;
+		const int coreId = isP ? cpu / 2 : cpu - 2;
+		snprintf(buf, sizeof(buf), "devices/system/cpu/cpu%d/topology/core_id", cpu);
+		char id[16];
+		snprintf(id, sizeof(id), "%d", coreId);
+		fs.put(buf, id);
+		if (isP) {
+			const char *siblings = cpu < 2 ? "0-1" : "2-3";
+			fs.putCache(cpu, 0, "Data", 1, "48K", 12, siblings);
+			fs.putCache(cpu, 1, "Instruction", 1, "32K", 8, siblings);
+			fs.putCache(cpu, 2, "Unified", 2, "2048K", 16, siblings);
+		} else {
+			snprintf(buf, sizeof(buf), "%d", cpu);
+			fs.putCache(cpu, 0, "Data", 1, "32K", 8, buf);
+			fs.putCache(cpu, 1, "Instruction", 1, "64K", 8, buf);
+			fs.putCache(cpu, 2, "Unified", 2, "4096K", 16, "4-7");
+		}
+		fs.putCache(cpu, 3, "Unified", 3, "36M", 12, "0-7");
+	}
+}
+
+static Cpu makeCpu(bool isHybrid)
+{
+	Cpu cpu;
+	// tINTEL and tHYBRID
+	const char *str = isHybrid ? "cpu1 1000000 200000000 6 a 2 0 b 6 ba 2 10 0 0 0 0" : "cpu1 1000000 0 6 a 2 0 b 6 ba 2 10 0 0 0 0";
+	CYBOZU_TEST_ASSERT(cpu.setStr(str));
+	return cpu;
+}
+
+CYBOZU_TEST_AUTO(hybrid)
+{
+	Sysfs fs;
+	CYBOZU_TEST_ASSERT(!fs.root.empty());
+	makeHybrid(fs);
+	const Cpu cpu = makeCpu(true);
+	CYBOZU_TEST_ASSERT(cpu.has(Cpu::tHYBRID));
+	CpuTopology topo(cpu, fs.root.c_str());
+	CYBOZU_TEST_EQUAL(topo.getLogicalCpuNum(), 8u);
+	CYBOZU_TEST_EQUAL(topo.getPhysicalCoreNum(), 6u);
+	CYBOZU_TEST_EQUAL(topo.getLineSize(), 64u);
+	CYBOZU_TEST_ASSERT(topo.isHybrid());
+	for (uint32_t i = 0; i < 8; i++) {
+		const LogicalCpu& lc = topo.getLogicalCpu(i);
+		const CpuCache& l1d = topo.getCache(i, L1d);
+		const CpuCache& l1i = topo.getCache(i, L1i);
+		const CpuCache& l2 = topo.getCache(i, L2);
+		const CpuCache& l3 = topo.getCache(i, L3);
+		if (i < 4) {
+			CYBOZU_TEST_EQUAL(lc.coreType, Performance);
+			CYBOZU_TEST_EQUAL(lc.coreId, i / 2);
+			CYBOZU_TEST_EQUAL(l1d.size, 48u * 1024);
+			CYBOZU_TEST_EQUAL(l1d.associativity, 12u);
+			CYBOZU_TEST_EQUAL(l1i.size, 32u * 1024);
+			CYBOZU_TEST_EQUAL(l2.size, 2048u * 1024);
+			CYBOZU_TEST_EQUAL(lc.getSiblings().getStr(), i < 2 ? "0-1" : "2-3");
+			CYBOZU_TEST_EQUAL(l2.getSharedCpuNum(), 2u);
+		} else {
+			CYBOZU_TEST_EQUAL(lc.coreType, Efficient);
+			CYBOZU_TEST_EQUAL(lc.coreId, i - 2);
+			CYBOZU_TEST_EQUAL(l1d.size, 32u * 1024);
+			CYBOZU_TEST_EQUAL(l1i.size, 64u * 1024);
+			CYBOZU_TEST_ASSERT(!l1d.isShared());
+			CYBOZU_TEST_EQUAL(l2.size, 4096u * 1024);
+			CYBOZU_TEST_EQUAL(l2.sharedCpuIndices.getStr(), "4-7");
+		}
+		CYBOZU_TEST_EQUAL(l3.size, 36u * 1024 * 1024);
+		CYBOZU_TEST_EQUAL(l3.associativity, 12u);
+		CYBOZU_TEST_EQUAL(l3.sharedCpuIndices.getStr(), "0-7");
+	}
+}
+
+CYBOZU_TEST_AUTO(nonHybrid)
+{
+	Sysfs fs;
+	makeHybrid(fs);
+	const Cpu cpu = makeCpu(false);
+	CpuTopology topo(cpu, fs.root.c_str());
+	CYBOZU_TEST_ASSERT(!topo.isHybrid());
+	for (uint32_t i = 0; i < topo.getLogicalCpuNum(); i++) {
+		CYBOZU_TEST_EQUAL(topo.getLogicalCpu(i).coreType, Standard);
+	}
+}
+
+CYBOZU_TEST_AUTO(hybridFallback)
+{
+	// without cpu_core/cpus or cpu_atom/cpus, the core type is read by CPUID on each core
+	const char *fileTbl[] = { "/devices/cpu_core/cpus", "/devices/cpu_atom/cpus" };
+	for (size_t i = 0; i < 2; i++) {
+		Sysfs fs;
+		makeHybrid(fs);
+		CYBOZU_TEST_EQUAL(unlink((fs.root + fileTbl[i]).c_str()), 0);
+		CpuMask org;
+		CYBOZU_TEST_ASSERT(getAffinity(org));
+		CpuTopology topo(makeCpu(true), fs.root.c_str());
+		// the affinity is restored
+		CpuMask cur;
+		CYBOZU_TEST_ASSERT(getAffinity(cur));
+		CYBOZU_TEST_ASSERT(cur == org);
+		// SMT siblings have the same core type
+		CYBOZU_TEST_EQUAL(topo.getLogicalCpu(0).coreType, topo.getLogicalCpu(1).coreType);
+		CYBOZU_TEST_EQUAL(topo.getLogicalCpu(2).coreType, topo.getLogicalCpu(3).coreType);
+		for (uint32_t j = 0; j < 8; j++) {
+			const CoreType coreType = topo.getLogicalCpu(j).coreType;
+			CYBOZU_TEST_ASSERT(coreType != Unknown);
+			// the thread can't run on the cpu
+			if (j >= 4 && !org.contains(j)) CYBOZU_TEST_EQUAL(coreType, Standard);
+		}
+		if (org.contains(0)) {
+			CpuMask m;
+			m.append(0);
+			CYBOZU_TEST_ASSERT(setAffinity(m));
+			CYBOZU_TEST_EQUAL(topo.getLogicalCpu(0).coreType, Xbyak::util::impl::getCoreType());
+			CYBOZU_TEST_ASSERT(setAffinity(org));
+		}
+	}
+}
+
+/*
+	node 0 : cpu 0-3, 16GiB
+	node 2 : cpu 4-7, 8GiB
+*/
+static void makeNuma(const Sysfs& fs)
+{
+	fs.put("devices/system/node/online", "0,2");
+	fs.put("devices/system/node/node0/cpulist", "0-3");
+	fs.put("devices/system/node/node0/distance", "10 21");
+	fs.put("devices/system/node/node0/meminfo", "Node 0 MemTotal:       16777216 kB\nNode 0 MemFree:        1000 kB");
+	fs.put("devices/system/node/node2/cpulist", "4-7");
+	fs.put("devices/system/node/node2/distance", "21 10");
+	fs.put("devices/system/node/node2/meminfo", "Node 2 MemTotal:       8388608 kB\nNode 2 MemFree:        1000 kB");
+}
+
+CYBOZU_TEST_AUTO(numa)
+{
+	Sysfs fs;
+	makeHybrid(fs);
+	makeNuma(fs);
+	CpuTopology topo(makeCpu(false), fs.root.c_str());
+	CYBOZU_TEST_EQUAL(topo.getNodeNum(), 2u);
+	const NumaNode& node0 = topo.getNode(0);
+	const NumaNode& node1 = topo.getNode(1);
+	CYBOZU_TEST_EQUAL(node0.id, 0u);
+	CYBOZU_TEST_EQUAL(node1.id, 2u);
+	CYBOZU_TEST_EQUAL(node0.memSize, uint64_t(16) << 30);
+	CYBOZU_TEST_EQUAL(node1.memSize, uint64_t(8) << 30);
+	CYBOZU_TEST_EQUAL(topo.getDistance(0, 0), 10u);
+	CYBOZU_TEST_EQUAL(topo.getDistance(0, 1), 21u);
+	CYBOZU_TEST_EQUAL(topo.getDistance(1, 0), 21u);
+	CYBOZU_TEST_EQUAL(topo.getLocalCpus(0).getStr(), "0-3");
+	CYBOZU_TEST_EQUAL(topo.getLocalCpus(1).getStr(), "4-7");
+	for (uint32_t i = 0; i < 8; i++) {
+		CYBOZU_TEST_EQUAL(topo.getLogicalCpu(i).nodeIdx, i < 4 ? 0u : 1u);
+	}
+	CpuMask m;
+	CYBOZU_TEST_ASSERT(m.setStr("1,2"));
+	std::vector<uint32_t> v = topo.getNodeIndices(m);
+	CYBOZU_TEST_EQUAL(v.size(), 1u);
+	CYBOZU_TEST_EQUAL(v[0], 0u);
+	m.clear();
+	CYBOZU_TEST_ASSERT(m.setStr("3-5"));
+	v = topo.getNodeIndices(m);
+	CYBOZU_TEST_EQUAL(v.size(), 2u);
+	CYBOZU_TEST_EQUAL(v[0], 0u);
+	CYBOZU_TEST_EQUAL(v[1], 1u);
+	m.clear();
+	CYBOZU_TEST_ASSERT(m.setStr("6"));
+	v = topo.getNodeIndices(m);
+	CYBOZU_TEST_EQUAL(v.size(), 1u);
+	CYBOZU_TEST_EQUAL(v[0], 1u);
+}
+
+CYBOZU_TEST_AUTO(noNuma)
+{
+	Sysfs fs;
+	makeHybrid(fs);
+	CpuTopology topo(makeCpu(false), fs.root.c_str());
+	// all cpus belong to one node
+	CYBOZU_TEST_EQUAL(topo.getNodeNum(), 1u);
+	CYBOZU_TEST_EQUAL(topo.getDistance(0, 0), 10u);
+	CYBOZU_TEST_EQUAL(topo.getLocalCpus(0).getStr(), "0-7");
+	CYBOZU_TEST_EQUAL(topo.getNode(0).memSize, 0u);
+}
+
+CYBOZU_TEST_AUTO(selectCpus)
+{
+	Sysfs fs;
+	makeHybrid(fs);
+	CpuTopology topo(makeCpu(true), fs.root.c_str());
+	// P-cores, E-cores, and then SMT siblings of P-cores
+	const uint32_t tbl[] = { 0, 2, 4, 5, 6, 7, 1, 3 };
+	std::vector<uint32_t> v = selectCpus(topo);
+	CYBOZU_TEST_EQUAL_ARRAY(v, tbl, 8);
+	v = selectCpus(topo, 3);
+	CYBOZU_TEST_EQUAL_ARRAY(v, tbl, 3);
+	v = selectCpus(topo, 100);
+	CYBOZU_TEST_EQUAL(v.size(), 8u);
+
+	std::vector<WorkRange> w = partitionWork(topo, 10, 3);
+	CYBOZU_TEST_EQUAL(w.size(), 3u);
+	const WorkRange expected[] = { { 0, 0, 4 }, { 2, 4, 7 }, { 4, 7, 10 } };
+	for (size_t i = 0; i < w.size(); i++) {
+		CYBOZU_TEST_EQUAL(w[i].cpuIdx, expected[i].cpuIdx);
+		CYBOZU_TEST_EQUAL(w[i].begin, expected[i].begin);
+		CYBOZU_TEST_EQUAL(w[i].end, expected[i].end);
+	}
+	w = partitionWork(topo, 3);
+	CYBOZU_TEST_EQUAL(w.size(), 8u);
+	for (size_t i = 0; i < w.size(); i++) {
+		CYBOZU_TEST_EQUAL(w[i].cpuIdx, tbl[i]);
+		CYBOZU_TEST_EQUAL(w[i].end - w[i].begin, i < 3 ? 1u : 0u);
+	}
+}
+
+CYBOZU_TEST_AUTO(nonHybridSelectCpus)
+{
+	Sysfs fs;
+	makeHybrid(fs);
+	CpuTopology topo(makeCpu(false), fs.root.c_str());
+	// E-cores share L2, so they are grouped
+	const uint32_t tbl[] = { 0, 2, 4, 5, 6, 7, 1, 3 };
+	std::vector<uint32_t> v = selectCpus(topo);
+	CYBOZU_TEST_EQUAL_ARRAY(v, tbl, 8);
+}
+
+CYBOZU_TEST_AUTO(cacheBlocking)
+{
+	Sysfs fs;
+	makeHybrid(fs);
+	CpuTopology topo(makeCpu(true), fs.root.c_str());
+	// one thread on cpu 0 ; L1d 48K, 12-way (one way is kept for C)
+	CacheBlocking b = getCacheBlocking(topo, 4, 3, 6, 16, 1);
+	CYBOZU_TEST_EQUAL(b.cacheSize[0], 48u * 1024 / 12 * 11);
+	CYBOZU_TEST_EQUAL(b.cacheSize[1], 2048u * 1024 / 16 * 15);
+	CYBOZU_TEST_EQUAL(b.cacheSize[2], 36u * 1024 * 1024 / 12 * 11);
+	CYBOZU_TEST_EQUAL(b.kc, 512u); // 45056 / ((6 + 16) * 4)
+	CYBOZU_TEST_EQUAL(b.mc, 942u); // (1966080 - 512 * 16 * 4) / (512 * 4) = 944
+	CYBOZU_TEST_EQUAL(b.nc, 15952u); // (34603008 - 942 * 512 * 4) / (512 * 4) = 15954
+	CYBOZU_TEST_EQUAL(b.mc % 6, 0u);
+	CYBOZU_TEST_EQUAL(b.nc % 16, 0u);
+
+	// all threads ; L1d and L2 of P-cores are shared by SMT siblings, L2 of E-cores by 4, L3 by 8
+	b = getCacheBlocking(topo, 4, 3, 6, 16);
+	CYBOZU_TEST_EQUAL(b.cacheSize[0], 48u * 1024 / 12 * 11 / 2);
+	CYBOZU_TEST_EQUAL(b.cacheSize[1], 4096u * 1024 / 16 * 15 / 4);
+	CYBOZU_TEST_EQUAL(b.cacheSize[2], 36u * 1024 * 1024 / 12 * 11 / 8);
+	CYBOZU_TEST_EQUAL(b.kc, 256u);
+	CYBOZU_TEST_EQUAL(b.mc, 942u);
+	CYBOZU_TEST_EQUAL(b.nc, 3280u);
+
+	// 4 threads on cpu 0, 2, 4, 5 ; no SMT sibling, E-core L2 is shared by 2
+	b = getCacheBlocking(topo, 4, 3, 6, 16, 4);
+	CYBOZU_TEST_EQUAL(b.cacheSize[0], 32u * 1024 / 8 * 7);
+	CYBOZU_TEST_EQUAL(b.cacheSize[1], 2048u * 1024 / 16 * 15);
+
+	// more streams keep more ways
+	b = getCacheBlocking(topo, 8, 5, 4, 8, 1);
+	CYBOZU_TEST_EQUAL(b.cacheSize[0], 48u * 1024 / 12 * 9);
+	CYBOZU_TEST_EQUAL(b.kc, 384u); // 36864 / ((4 + 8) * 8)
+	CYBOZU_TEST_EQUAL(b.kc % 8, 0u);
+}
+
+CYBOZU_TEST_AUTO(affinity)
+{
+	CpuMask org;
+	CYBOZU_TEST_ASSERT(getAffinity(org));
+	CYBOZU_TEST_ASSERT(!org.empty());
+	CpuMask m;
+	CYBOZU_TEST_ASSERT(m.append(*org.begin()));
+	CYBOZU_TEST_ASSERT(setAffinity(m));
+	CpuMask cur;
+	CYBOZU_TEST_ASSERT(getAffinity(cur));
+	CYBOZU_TEST_ASSERT(cur == m);
+	CYBOZU_TEST_ASSERT(setAffinity(org));
+	CYBOZU_TEST_ASSERT(getAffinity(cur));
+	CYBOZU_TEST_ASSERT(cur == org);
+	CYBOZU_TEST_ASSERT(!setAffinity(CpuMask()));
+
+#ifdef XBYAK_UTIL_HAS_THREAD
+	CpuMask inThread;
+	std::thread t([&]() {
+		// wait for setAffinity
+		for (int i = 0; i < 100; i++) {
+			getAffinity(inThread);
+			if (inThread == m) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	CYBOZU_TEST_ASSERT(setAffinity(t, m));
+	t.join();
+	CYBOZU_TEST_ASSERT(inThread == m);
+#endif
+}
+
+#ifdef XBYAK_UTIL_HAS_THREAD
+CYBOZU_TEST_AUTO(threadPool)
+{
+	Sysfs fs;
+	makeHybrid(fs);
+	CpuTopology topo(makeCpu(false), fs.root.c_str());
+	ThreadPool pool(topo);
+	CYBOZU_TEST_EQUAL(pool.getThreadNum(), 8u);
+	// workers are placed in the order of selectCpus
+	const uint32_t cpuTbl[] = { 0, 2, 4, 5, 6, 7, 1, 3 };
+	for (size_t i = 0; i < 8; i++) {
+		CYBOZU_TEST_EQUAL(pool.getCpuIdx(i), cpuTbl[i]);
+	}
+	// cpu0 steals from the SMT sibling cpu1 first
+	const size_t order0[] = { 6, 1, 2, 3, 4, 5, 7 };
+	CYBOZU_TEST_EQUAL_ARRAY(pool.getStealOrder(0), order0, 7);
+	// cpu4 steals from cpu5-7 sharing L2 first
+	const size_t order2[] = { 3, 4, 5, 0, 1, 6, 7 };
+	CYBOZU_TEST_EQUAL_ARRAY(pool.getStealOrder(2), order2, 7);
+
+	// tasks submitted by a worker are pushed to its own queue and stolen by idle workers
+	std::atomic<int> sum(0);
+	pool.submit([&]() {
+		for (int i = 0; i < 64; i++) {
+			pool.submit([&]() {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				sum++;
+			});
+		}
+	});
+	pool.wait();
+	CYBOZU_TEST_EQUAL(sum, 64);
+	uint64_t taskNum = 0, stealNum = 0;
+	for (size_t i = 0; i < 8; i++) {
+		taskNum += pool.getStats(i).taskNum;
+		stealNum += pool.getStats(i).stealNum;
+	}
+	CYBOZU_TEST_EQUAL(taskNum, 65u);
+	CYBOZU_TEST_ASSERT(stealNum > 0);
+
+	// parallelFor in every worker does not deadlock
+	sum = 0;
+	pool.parallelFor(64, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			pool.parallelFor(64, [&](size_t b, size_t e) { sum += int(e - b); });
+		}
+	});
+	CYBOZU_TEST_EQUAL(sum, 64 * 64);
+}
+
+CYBOZU_TEST_AUTO(threadPoolCoreType)
+{
+	Sysfs fs;
+	makeHybrid(fs);
+	CpuTopology topo(makeCpu(true), fs.root.c_str());
+	ThreadPool pool(topo, 0, Efficient);
+	CYBOZU_TEST_EQUAL(pool.getThreadNum(), 4u);
+	for (size_t i = 0; i < 4; i++) {
+		CYBOZU_TEST_EQUAL(topo.getLogicalCpu(pool.getCpuIdx(i)).coreType, Efficient);
+	}
+}
+#endif
+
+CYBOZU_TEST_AUTO(noSysfs)
+{
+	Sysfs fs;
+	const Cpu cpu = makeCpu(false);
+	CYBOZU_TEST_EXCEPTION(CpuTopology(cpu, fs.root.c_str()), Xbyak::Error);
+}
+
+CYBOZU_TEST_AUTO(system)
+{
+	const Cpu& cpu = Cpu::getInstance();
+	CpuTopology topo(cpu);
+	CYBOZU_TEST_ASSERT(topo.getLogicalCpuNum() > 0);
+	// count the online cpuN directories independently of CpuTopology
+	size_t onlineNum = 0;
+	DIR *dir = opendir("/sys/devices/system/cpu");
+	CYBOZU_TEST_ASSERT(dir);
+	if (dir) {
+		while (const struct dirent *e = readdir(dir)) {
+			unsigned int idx;
+			char c;
+			if (sscanf(e->d_name, "cpu%u%c", &idx, &c) != 1) continue;
+			// cpu0 may not have the online file
+			char path[512];
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/%s/online", e->d_name);
+			FILE *fp = fopen(path, "r");
+			int online = 1;
+			if (fp) {
+				if (fscanf(fp, "%d", &online) != 1) online = 0;
+				fclose(fp);
+			}
+			if (online) onlineNum++;
+		}
+		closedir(dir);
+	}
+	CYBOZU_TEST_EQUAL(topo.getLogicalCpuNum(), onlineNum);
+	CYBOZU_TEST_ASSERT(topo.getLogicalCpuNum() <= size_t(sysconf(_SC_NPROCESSORS_CONF)));
+	CYBOZU_TEST_ASSERT(topo.getNodeNum() > 0);
+	size_t n = 0;
+	for (size_t i = 0; i < topo.getNodeNum(); i++) {
+		n += topo.getLocalCpus(i).size();
+		CYBOZU_TEST_EQUAL(topo.getDistance(i, i), 10u);
+	}
+	CYBOZU_TEST_EQUAL(n, topo.getLogicalCpuNum());
+	// a cache is shared by the cpu itself
+	for (uint32_t i = 0; i < topo.getLogicalCpuNum(); i++) {
+		for (int j = 0; j < CACHE_TYPE_NUM; j++) {
+			const CpuCache& c = topo.getCache(i, CacheType(j));
+			if (c.size == 0) continue;
+			CYBOZU_TEST_ASSERT(c.sharedCpuIndices.contains(i));
+		}
+	}
+}
+
+#endif
@@ -1968,3 +1968,148 @@ CYBOZU_TEST_AUTO(resetAfterProtectRE_DontSetProtectRWE)
 	int (*f2)() = code.getCode<int (*)()>();
 	CYBOZU_TEST_EQUAL(f2(), 2);
 }
+
+CYBOZU_TEST_AUTO(coldSection)
+{
+	struct Code : Xbyak::CodeGenerator {
+		Code() : Xbyak::CodeGenerator(4096)
+		{
+			setColdSection(1024);
+			gen();
+		}
+		void gen()
+		{
+			Label slow, back;
+			mov(eax, 3);
+			cmp(eax, 3);
+			je(slow, T_NEAR);
+			mov(eax, 1);
+			L(back);
+			add(eax, 10);
+			ret();
+			switchToCold();
+			L(slow);
+			mov(eax, 5);
+			jmp(back);
+		}
+	} c;
+	CYBOZU_TEST_ASSERT(c.isCold());
+	c.ready();
+	CYBOZU_TEST_ASSERT(!c.isCold());
+	CYBOZU_TEST_EQUAL(c.getCode<int (*)()>()(), 15);
+	CYBOZU_TEST_ASSERT(c.getColdCode() >= c.getCurr());
+	CYBOZU_TEST_ASSERT(c.getColdCode() <= c.getCode() + 4096 - 1024);
+	CYBOZU_TEST_EQUAL(size_t(c.getColdCode()) % 64, 0u);
+	CYBOZU_TEST_EQUAL(c.getColdSize(), 10u); // mov eax, 5 + jmp rel32
+	// the cold section is kept after reset
+	c.reset();
+	CYBOZU_TEST_EQUAL(c.getSize(), 0u);
+	CYBOZU_TEST_EQUAL(c.getColdSize(), 0u);
+	c.gen();
+	c.ready();
+	CYBOZU_TEST_EQUAL(c.getCode<int (*)()>()(), 15);
+	CYBOZU_TEST_EQUAL(c.getColdSize(), 10u);
+}
+
+CYBOZU_TEST_AUTO(coldSectionOverflow)
+{
+	struct Code : Xbyak::CodeGenerator {
+		Code() : Xbyak::CodeGenerator(4096) {}
+	} c;
+	c.setColdSection(4096 - 64);
+	CYBOZU_TEST_EQUAL(c.getColdCode(), c.getCode() + 64);
+	c.nop(64, false);
+	CYBOZU_TEST_EXCEPTION(c.db(0x90), Xbyak::Error);
+	c.switchToCold();
+	c.db(0x90);
+	CYBOZU_TEST_EQUAL(c.getColdSize(), 1u);
+	c.switchToHot();
+	CYBOZU_TEST_EQUAL(c.getSize(), 64u);
+	CYBOZU_TEST_EXCEPTION(c.setColdSection(128), Xbyak::Error);
+
+	struct AutoGrowCode : Xbyak::CodeGenerator {
+		AutoGrowCode() : Xbyak::CodeGenerator(4096, Xbyak::AutoGrow) {}
+	} g;
+	CYBOZU_TEST_EXCEPTION(g.setColdSection(1024), Xbyak::Error);
+	CYBOZU_TEST_EXCEPTION(g.switchToCold(), Xbyak::Error);
+}
+
+#ifdef XBYAK64
+CYBOZU_TEST_AUTO(veneer)
+{
+	struct Code : Xbyak::CodeGenerator {
+		// return f() + f() if it is not equal to v else f()
+		Code(const void *f, int v, void *buf)
+			: Xbyak::CodeGenerator(4096, buf)
+		{
+			setVeneer(true);
+			sub(rsp, 8);
+			call(f);
+			mov(ecx, eax);
+			call(f);
+			add(ecx, eax);
+			add(rsp, 8);
+			cmp(ecx, v);
+			je(f);
+			mov(eax, ecx);
+			ret();
+		}
+	};
+	const uint8_t retSeven[] = { 0xb8, 0x07, 0x00, 0x00, 0x00, 0xc3 }; // mov eax, 7; ret
+	const uint32_t size = 4096;
+	uint8_t *low = (uint8_t*)get32bitAddress(size);
+	CYBOZU_TEST_ASSERT(low);
+	Xbyak::CodeGenerator high;
+	high.db(retSeven, sizeof(retSeven));
+	const bool isFar = !inner::IsInInt32(size_t(high.getCode()) - size_t(low));
+
+	// non AutoGrow code calls a far function without ready()
+	for (int v = 14; v <= 15; v++) {
+		Code c(high.getCode(), v, low);
+		if (isFar) {
+			// one stub for the target at the end of the buffer
+			const uint8_t *stub = c.getCode() + 4096 - 14;
+			CYBOZU_TEST_EQUAL(stub[0], 0xFF);
+			CYBOZU_TEST_EQUAL(stub[1], 0x25);
+			const void *target = high.getCode();
+			CYBOZU_TEST_EQUAL(memcmp(stub + 6, &target, 8), 0);
+		}
+		CYBOZU_TEST_ASSERT(Xbyak::CodeArray::protect(low, size, Xbyak::CodeArray::PROTECT_RWE));
+		CYBOZU_TEST_EQUAL(c.getCode<int (*)()>()(), v == 14 ? 7 : 14);
+		CYBOZU_TEST_ASSERT(Xbyak::CodeArray::protect(low, size, Xbyak::CodeArray::PROTECT_RW));
+	}
+	if (isFar) {
+		struct NoVeneer : Xbyak::CodeGenerator {
+			NoVeneer(const void *f, void *buf) : Xbyak::CodeGenerator(4096, buf) { call(f); }
+		};
+		CYBOZU_TEST_EXCEPTION(NoVeneer(high.getCode(), low), Xbyak::Error);
+
+		// the hot code can't overwrite the stub
+		struct Full : Xbyak::CodeGenerator {
+			Full(const void *f, void *buf) : Xbyak::CodeGenerator(64, buf)
+			{
+				setVeneer(true);
+				call(f);
+				nop(64 - 5 - 14, false);
+			}
+		} c(high.getCode(), low);
+		CYBOZU_TEST_EQUAL(c.getSize(), 64u - 14);
+		CYBOZU_TEST_EXCEPTION(c.db(0x90), Xbyak::Error);
+		// reset() removes the stub
+		c.reset();
+		c.nop(64, false);
+		CYBOZU_TEST_EQUAL(c.getSize(), 64u);
+	}
+
+	// AutoGrow code calls a far function
+	memcpy(low, retSeven, sizeof(retSeven));
+	CYBOZU_TEST_ASSERT(Xbyak::CodeArray::protect(low, size, Xbyak::CodeArray::PROTECT_RE));
+	for (int v = 14; v <= 15; v++) {
+		Code c(low, v, Xbyak::AutoGrow);
+		c.readyRE();
+		CYBOZU_TEST_EQUAL(c.getCode<int (*)()>()(), v == 14 ? 7 : 14);
+	}
+	CYBOZU_TEST_ASSERT(Xbyak::CodeArray::protect(low, size, Xbyak::CodeArray::PROTECT_RW));
+	free32bitAddress(low, size);
+}
+#endif
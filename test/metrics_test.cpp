@@ -0,0 +1,162 @@
+#define XBYAK_USE_METRICS
+#include <xbyak/xbyak.h>
+#include <cybozu/test.hpp>
+#include <thread>
+#include <vector>
+
+using namespace Xbyak;
+
+struct Code : Xbyak::CodeGenerator {
+	explicit Code(int n, void *userPtr = 0)
+		: Xbyak::CodeGenerator(4096, userPtr)
+	{
+		Label skip;
+		for (int i = 0; i < n; i++) {
+			L(std::string("@@"));
+			nop();
+		}
+		jmp(skip);
+		L(skip);
+		mov(eax, n);
+		ret();
+	}
+};
+
+CYBOZU_TEST_AUTO(metrics)
+{
+	MetricsRegistry& reg = MetricsRegistry::getInstance();
+	reg.clear();
+	Code c(3);
+	const Metrics& m = c.getMetrics();
+	CYBOZU_TEST_EQUAL(m.labelNum, 4u);
+	CYBOZU_TEST_EQUAL(m.allocBytes, 4096u);
+	CYBOZU_TEST_EQUAL(m.growNum, 0u);
+	CYBOZU_TEST_EQUAL(reg.getCount(), 0u);
+	c.ready();
+	CYBOZU_TEST_EQUAL(c.getCode<int (*)()>()(), 3);
+	CYBOZU_TEST_EQUAL(reg.getCount(), 1u);
+	CYBOZU_TEST_EQUAL(m.codeBytes, c.getSize());
+	CYBOZU_TEST_ASSERT(m.genNs > 0);
+	CYBOZU_TEST_ASSERT(m.genTsc > 0);
+	// ready() records the metrics only once
+	c.ready();
+	CYBOZU_TEST_EQUAL(reg.getCount(), 1u);
+	const Metrics t = reg.getTotal();
+	CYBOZU_TEST_EQUAL(t.codeBytes, c.getSize());
+	CYBOZU_TEST_EQUAL(t.labelNum, 4u);
+	CYBOZU_TEST_EQUAL(t.insnNum, 6u);
+}
+
+// each line is one instruction except the prefixes
+struct Mixed : Xbyak::CodeGenerator {
+	Mixed()
+	{
+		Label lp;
+		L(lp);
+		lock(); add(ptr[eax], ecx);
+		rep(); movsb();
+		add(eax, 3);
+		add(ecx, 0x12345);
+		test(eax, 1);
+		imul(eax, ecx, 5);
+		inc(ecx);
+		push(rax);
+		pop(rax);
+		push(3);
+		mov(eax, 0x12345678);
+		mov(rax, 0x123456789);
+		mov(ecx, ptr[eax + 4]);
+		xchg(eax, ecx);
+		movzx(eax, cx);
+		bswap(eax);
+		cpuid();
+		fld(dword[eax]);
+		fadd(st0, st1);
+		addps(xmm0, xmm1);
+		vaddps(ymm0, ymm1, ptr[eax]);
+		vaddps(zmm0, zmm1, zmm2);
+		nop();
+		nop(5);
+		jmp(lp);
+		jnz(lp, T_NEAR);
+		call(lp);
+		ret();
+	}
+};
+
+CYBOZU_TEST_AUTO(insnNum)
+{
+	Code c(3);
+	// nop * 3, jmp, mov, ret
+	CYBOZU_TEST_EQUAL(c.getMetrics().insnNum, 6u);
+	Mixed m;
+	CYBOZU_TEST_EQUAL(m.getMetrics().insnNum, 28u);
+}
+
+CYBOZU_TEST_AUTO(autoGrow)
+{
+	MetricsRegistry& reg = MetricsRegistry::getInstance();
+	reg.clear();
+	{
+		struct Big : Xbyak::CodeGenerator {
+			Big() : Xbyak::CodeGenerator(16, Xbyak::AutoGrow)
+			{
+				for (int i = 0; i < 1000; i++) nop();
+				ret();
+			}
+		} c;
+		c.ready();
+		const Metrics& m = c.getMetrics();
+		CYBOZU_TEST_ASSERT(m.growNum > 0);
+		CYBOZU_TEST_ASSERT(m.allocBytes > 1000);
+		CYBOZU_TEST_EQUAL(m.codeBytes, 1001u);
+	}
+	// the destructor records a generator which did not call ready()
+	{
+		Code c(1);
+		CYBOZU_TEST_EQUAL(reg.getCount(), 1u);
+	}
+	CYBOZU_TEST_EQUAL(reg.getCount(), 2u);
+}
+
+CYBOZU_TEST_AUTO(records)
+{
+	MetricsRegistry& reg = MetricsRegistry::getInstance();
+	reg.clear();
+	reg.setMaxRecordNum(3);
+	for (int i = 0; i < 5; i++) {
+		Code c(i);
+		c.ready();
+	}
+	CYBOZU_TEST_EQUAL(reg.getCount(), 5u);
+	std::vector<Metrics> v = reg.getRecords();
+	CYBOZU_TEST_EQUAL(v.size(), 3u);
+	// the latest records are kept
+	for (size_t i = 0; i < v.size(); i++) {
+		CYBOZU_TEST_EQUAL(v[i].labelNum, i + 2 + 1);
+	}
+	size_t n = 0;
+	reg.forEach([&](const Metrics&) { n++; });
+	CYBOZU_TEST_EQUAL(n, 3u);
+	reg.setMaxRecordNum(1024);
+}
+
+CYBOZU_TEST_AUTO(multiThread)
+{
+	MetricsRegistry& reg = MetricsRegistry::getInstance();
+	reg.clear();
+	const int threadNum = 4;
+	const int loopNum = 100;
+	std::vector<std::thread> tv;
+	for (int i = 0; i < threadNum; i++) {
+		tv.emplace_back([]() {
+			for (int j = 0; j < loopNum; j++) {
+				Code c(2);
+				c.ready();
+			}
+		});
+	}
+	for (size_t i = 0; i < tv.size(); i++) tv[i].join();
+	CYBOZU_TEST_EQUAL(reg.getCount(), size_t(threadNum * loopNum));
+	CYBOZU_TEST_EQUAL(reg.getTotal().labelNum, size_t(threadNum * loopNum * 3));
+}
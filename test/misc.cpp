@@ -527,6 +527,58 @@ CYBOZU_TEST_AUTO(cpu)
 	CYBOZU_TEST_EQUAL(cpu.has(Cpu::tINTEL) && cpu.has(Cpu::tAMD), cpu.has(Cpu::tINTEL | Cpu::tAMD));
 }
 
+CYBOZU_TEST_AUTO(cpuStr)
+{
+	using namespace Xbyak::util;
+	const Cpu& cpu = Cpu::getInstance();
+	CYBOZU_TEST_EQUAL(&cpu, &Cpu::getInstance());
+	const std::string s = cpu.getStr();
+	Cpu cpu2;
+	CYBOZU_TEST_ASSERT(cpu2.setStr(s));
+	CYBOZU_TEST_EQUAL(cpu2.getStr(), s);
+	CYBOZU_TEST_ASSERT(cpu2.has(Cpu::tSSE2) == cpu.has(Cpu::tSSE2));
+	CYBOZU_TEST_EQUAL(cpu2.displayModel, cpu.displayModel);
+	CYBOZU_TEST_EQUAL(cpu2.getDataCacheLevels(), cpu.getDataCacheLevels());
+	for (uint32_t i = 0; i < cpu.getDataCacheLevels(); i++) {
+		CYBOZU_TEST_EQUAL(cpu2.getDataCacheSize(i), cpu.getDataCacheSize(i));
+		CYBOZU_TEST_EQUAL(cpu2.getCoresSharingDataCache(i), cpu.getCoresSharingDataCache(i));
+	}
+
+	// inject a cpu without AVX-512 and AVX10
+	Cpu cpu3;
+	CYBOZU_TEST_ASSERT(cpu3.setStr("cpu1 1000003 0 6 f 1 0 8 6 8f 2 40 0 0 0 2 c000 1 200000 2"));
+	CYBOZU_TEST_ASSERT(cpu3.has(Cpu::tMMX));
+	CYBOZU_TEST_ASSERT(cpu3.has(Cpu::tMMX2));
+	CYBOZU_TEST_ASSERT(!cpu3.has(Cpu::tSSE));
+	CYBOZU_TEST_ASSERT(cpu3.has(Cpu::tINTEL));
+	CYBOZU_TEST_EQUAL(cpu3.displayModel, 0x8f);
+	CYBOZU_TEST_EQUAL(cpu3.getNumCores(SmtLevel), 2u);
+	CYBOZU_TEST_EQUAL(cpu3.getNumCores(CoreLevel), 32u);
+	CYBOZU_TEST_EQUAL(cpu3.getDataCacheLevels(), 2u);
+	CYBOZU_TEST_EQUAL(cpu3.getDataCacheSize(1), 0x200000u);
+	CYBOZU_TEST_EQUAL(cpu3.getCoresSharingDataCache(1), 2u);
+	const Cpu saved = Cpu::getInstance();
+	Cpu::setInstance(cpu3);
+	CYBOZU_TEST_EQUAL(Cpu::getInstance().getStr(), cpu3.getStr());
+	Cpu::setInstance(saved);
+	CYBOZU_TEST_EQUAL(Cpu::getInstance().getStr(), s);
+
+	// invalid strings do not change the cpu
+	const char *badTbl[] = {
+		"",
+		"cpu2 0",
+		"cpu1 1 0 6 f 1 0 8 6 8f 2 40 0 0 0",
+		"cpu1 1 0 6 f 1 0 8 6 8f 2 40 0 0 0 1",
+		"cpu1 1 0 6 f 1 0 8 6 8f 2 40 0 0 0 0 1",
+		"cpu1 1 0 6 f 1 0 8 6 8f 2 40 0 0 0 b",
+		"cpu1 1 0 6 f 1 0 8 6 8f 2 40 0 0 0 0x",
+	};
+	for (size_t i = 0; i < sizeof(badTbl) / sizeof(badTbl[0]); i++) {
+		CYBOZU_TEST_ASSERT(!cpu2.setStr(badTbl[i]));
+		CYBOZU_TEST_EQUAL(cpu2.getStr(), s);
+	}
+}
+
 CYBOZU_TEST_AUTO(minmax)
 {
 	using namespace Xbyak::util;
@@ -660,3 +712,56 @@ CYBOZU_TEST_AUTO(vmovw)
 }
 
 #endif
+
+CYBOZU_TEST_AUTO(CodeCache)
+{
+	struct Code : Xbyak::CodeGenerator {
+		explicit Code(int v) : Xbyak::CodeGenerator(16, Xbyak::AutoGrow)
+		{
+			Label L1;
+			mov(ecx, v);
+#ifdef XBYAK64
+			mov(rax, L1);
+			jmp(rax);
+#else
+			mov(eax, L1);
+			jmp(eax);
+#endif
+			nop(32); // make AutoGrow reallocate the buffer
+			L(L1);
+			mov(eax, ecx);
+			ret();
+		}
+	};
+	Code a(1), b(1), c(2);
+	CYBOZU_TEST_EQUAL(a.getCodeHash(), b.getCodeHash());
+	CYBOZU_TEST_ASSERT(a.getCodeHash() != c.getCodeHash());
+	a.ready();
+	CYBOZU_TEST_EQUAL(a.getCodeHash(), b.getCodeHash());
+
+	util::CodeCache cache;
+	int (*fa)() = cache.acquire<int (*)()>(a);
+	int (*fb)() = cache.acquire<int (*)()>(b);
+	int (*fc)() = cache.acquire<int (*)()>(c);
+	CYBOZU_TEST_EQUAL(fa, fb);
+	CYBOZU_TEST_ASSERT(fa != fc);
+	CYBOZU_TEST_EQUAL(fa(), 1);
+	CYBOZU_TEST_EQUAL(fc(), 2);
+	CYBOZU_TEST_EQUAL(cache.getEntryNum(), 2u);
+	CYBOZU_TEST_EQUAL(cache.getCodeSize(), a.getSize() * 2);
+	CYBOZU_TEST_EQUAL(cache.getRefCount((const void*)fa), 2u);
+
+	cache.release((const void*)fa);
+	CYBOZU_TEST_EQUAL(cache.getRefCount((const void*)fa), 1u);
+	cache.release((const void*)fb);
+	CYBOZU_TEST_EQUAL(cache.getRefCount((const void*)fa), 0u);
+	CYBOZU_TEST_EQUAL(cache.getEntryNum(), 1u);
+	CYBOZU_TEST_EQUAL(fc(), 2);
+	cache.release((const void*)fc);
+	CYBOZU_TEST_EQUAL(cache.getEntryNum(), 0u);
+	CYBOZU_TEST_EQUAL(cache.getCodeSize(), 0u);
+	CYBOZU_TEST_EXCEPTION(cache.release((const void*)fc), Xbyak::Error);
+
+	Xbyak::CodeGenerator notAutoGrow;
+	CYBOZU_TEST_EXCEPTION(cache.acquire(notAutoGrow), Xbyak::Error);
+}
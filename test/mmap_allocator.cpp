@@ -74,6 +74,104 @@ CYBOZU_TEST_AUTO(twoInstancesAreIsolated)
 	CYBOZU_TEST_NO_EXCEPTION(a.free(p));
 }
 
+#ifdef __linux__
+static int anchorFunc() { return 5; }
+
+CYBOZU_TEST_AUTO(nearAddr)
+{
+	const uint8_t *anchor = (const uint8_t*)anchorFunc;
+	MmapAllocator alloc;
+	alloc.setNearAddr(anchor);
+	uint8_t *tbl[4];
+	for (int i = 0; i < 4; i++) {
+		const size_t size = 65536;
+		tbl[i] = alloc.alloc(size);
+		CYBOZU_TEST_ASSERT(inner::IsInInt32(size_t(tbl[i]) - size_t(anchor)));
+		CYBOZU_TEST_ASSERT(inner::IsInInt32(size_t(tbl[i] + size) - size_t(anchor)));
+		memset(tbl[i], 0, size);
+	}
+	for (int i = 0; i < 4; i++) {
+		CYBOZU_TEST_NO_EXCEPTION(alloc.free(tbl[i]));
+	}
+
+	// call rel32 to anchorFunc
+	struct Code : Xbyak::CodeGenerator {
+		explicit Code(Allocator *alloc)
+			: Xbyak::CodeGenerator(4096, 0, alloc)
+		{
+			sub(rsp, 8);
+			call((const void*)anchorFunc);
+			add(eax, 1);
+			add(rsp, 8);
+			ret();
+		}
+	} c(&alloc);
+	CYBOZU_TEST_EQUAL(c.getCode<int (*)()>()(), 6);
+}
+#endif
+
+CYBOZU_TEST_AUTO(stats)
+{
+	MmapAllocator alloc;
+	const size_t pageSize = inner::getPageSize();
+	std::vector<uint8_t*> v;
+	for (int i = 0; i < 3; i++) v.push_back(alloc.alloc(pageSize + 1));
+	MmapAllocator::Stats st = alloc.getStats();
+	CYBOZU_TEST_EQUAL(st.liveBytes, pageSize * 2 * 3);
+	CYBOZU_TEST_EQUAL(st.peakBytes, pageSize * 2 * 3);
+	CYBOZU_TEST_EQUAL(st.liveCount, 3u);
+	CYBOZU_TEST_EQUAL(st.allocCount, 3u);
+#if defined(XBYAK_USE_MEMFD)
+	CYBOZU_TEST_EQUAL(st.memfdCount, 3u);
+#else
+	CYBOZU_TEST_EQUAL(st.memfdCount, 0u);
+#endif
+	alloc.free(v[1]);
+	alloc.free(v[0]);
+	st = alloc.getStats();
+	CYBOZU_TEST_EQUAL(st.liveBytes, pageSize * 2);
+	CYBOZU_TEST_EQUAL(st.peakBytes, pageSize * 2 * 3);
+	CYBOZU_TEST_EQUAL(st.liveCount, 1u);
+	CYBOZU_TEST_EQUAL(st.allocCount, 3u);
+	alloc.free(v[2]);
+	st = alloc.getStats();
+	CYBOZU_TEST_EQUAL(st.liveBytes, 0u);
+	CYBOZU_TEST_EQUAL(st.liveCount, 0u);
+	CYBOZU_TEST_EQUAL(st.memfdCount, 0u);
+}
+
+CYBOZU_TEST_AUTO(manyAllocations)
+{
+	MmapAllocator alloc;
+	const size_t n = 20000;
+	std::vector<uint8_t*> v(n);
+	for (size_t i = 0; i < n; i++) v[i] = alloc.alloc(64);
+	// free in the allocation order
+	for (size_t i = 0; i < n; i++) alloc.free(v[i]);
+	CYBOZU_TEST_EQUAL(alloc.getStats().liveCount, 0u);
+	CYBOZU_TEST_EQUAL(alloc.getStats().allocCount, n);
+}
+
+CYBOZU_TEST_AUTO(populateAndLock)
+{
+	MmapAllocator alloc;
+	alloc.setPopulate(true);
+	alloc.setLock(true);
+	const size_t pageSize = inner::getPageSize();
+	const size_t n = 16;
+	uint8_t *p = alloc.alloc(pageSize * n);
+	CYBOZU_TEST_ASSERT(p);
+#ifdef __linux__
+	// all pages are resident before they are touched
+	unsigned char vec[n];
+	CYBOZU_TEST_EQUAL(mincore(p, pageSize * n, vec), 0);
+	for (size_t i = 0; i < n; i++) {
+		CYBOZU_TEST_ASSERT(vec[i] & 1);
+	}
+#endif
+	CYBOZU_TEST_NO_EXCEPTION(alloc.free(p));
+}
+
 #if defined(XBYAK_USE_MEMFD)
 CYBOZU_TEST_AUTO(memfdSurvivorAfterSwap)
 {
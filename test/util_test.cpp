@@ -0,0 +1,771 @@
+#include <stdio.h>
+#include <math.h>
+#ifdef __linux__
+	#define XBYAK_USE_MEMFD
+#endif
+#include <xbyak/xbyak_util.h>
+#include <cybozu/test.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+using namespace Xbyak;
+
+struct Kernel : Xbyak::CodeGenerator {
+	explicit Kernel(int v)
+		: Xbyak::CodeGenerator(4096)
+	{
+		mov(eax, v);
+		ret();
+	}
+	int operator()() const { return getCode<int (*)()>()(); }
+};
+
+CYBOZU_TEST_AUTO(KernelCache)
+{
+	typedef util::KernelCache<int, Kernel> Cache;
+	const size_t kernelSize = Kernel(0).getSize();
+	Cache cache(kernelSize * 3, 1);
+	for (int i = 0; i < 3; i++) {
+		Cache::CodePtr p = cache.get(i);
+		CYBOZU_TEST_EQUAL((*p)(), i);
+	}
+	CYBOZU_TEST_EQUAL(cache.size(), 3u);
+	CYBOZU_TEST_EQUAL(cache.getCodeSize(), kernelSize * 3);
+	Cache::CodePtr p0 = cache.get(0); // 0 becomes the most recently used
+	CYBOZU_TEST_EQUAL((*p0)(), 0);
+	Cache::Stats st = cache.getStats();
+	CYBOZU_TEST_EQUAL(st.hit, 1u);
+	CYBOZU_TEST_EQUAL(st.miss, 3u);
+	CYBOZU_TEST_EQUAL(st.eviction, 0u);
+
+	// 1 is evicted
+	Cache::CodePtr p3 = cache.get(3);
+	CYBOZU_TEST_EQUAL((*p3)(), 3);
+	st = cache.getStats();
+	CYBOZU_TEST_EQUAL(st.eviction, 1u);
+	CYBOZU_TEST_EQUAL(cache.size(), 3u);
+	cache.get(0);
+	cache.get(2);
+	CYBOZU_TEST_EQUAL(cache.getStats().hit, 3u);
+	cache.get(1);
+	CYBOZU_TEST_EQUAL(cache.getStats().miss, 5u);
+
+	cache.clear();
+	CYBOZU_TEST_EQUAL(cache.size(), 0u);
+	CYBOZU_TEST_EQUAL(cache.getCodeSize(), 0u);
+	// the returned kernels are still alive
+	CYBOZU_TEST_EQUAL((*p0)(), 0);
+	CYBOZU_TEST_EQUAL((*p3)(), 3);
+}
+
+CYBOZU_TEST_AUTO(KernelCache_singleFlight)
+{
+	typedef util::KernelCache<int, Kernel> Cache;
+	Cache cache(1024 * 1024);
+	std::atomic<int> genNum(0);
+	const int threadNum = 8;
+	const int keyNum = 4;
+	std::atomic<int> errNum(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadNum; t++) {
+		threads.emplace_back([&]() {
+			for (int k = 0; k < keyNum; k++) {
+				Cache::CodePtr p = cache.get(k, [&](int key) {
+					genNum++;
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+					return std::make_shared<Kernel>(key);
+				});
+				if ((*p)() != k) errNum++;
+			}
+		});
+	}
+	for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+	CYBOZU_TEST_EQUAL(errNum, 0);
+	CYBOZU_TEST_EQUAL(genNum, keyNum);
+	const Cache::Stats st = cache.getStats();
+	CYBOZU_TEST_EQUAL(st.miss, uint64_t(keyNum));
+	CYBOZU_TEST_EQUAL(st.hit, uint64_t(threadNum * keyNum - keyNum));
+}
+
+CYBOZU_TEST_AUTO(KernelCache_genFailure)
+{
+	typedef util::KernelCache<int, Kernel> Cache;
+	Cache cache(1024 * 1024);
+	CYBOZU_TEST_EXCEPTION(cache.get(1, [](int) -> Cache::CodePtr { throw Xbyak::Error(ERR_CANT_ALLOC); }), Xbyak::Error);
+	CYBOZU_TEST_ASSERT(!cache.get(1, [](int) { return Cache::CodePtr(); }));
+	CYBOZU_TEST_EQUAL((*cache.get(1))(), 1);
+	CYBOZU_TEST_EQUAL(cache.size(), 1u);
+}
+
+// loop n times
+struct LoopKernel : Xbyak::CodeGenerator {
+	explicit LoopKernel(int n)
+	{
+		mov(eax, n);
+		Label lp;
+		L(lp);
+		imul(ecx, ecx);
+		dec(eax);
+		jnz(lp);
+		ret();
+	}
+};
+
+CYBOZU_TEST_AUTO(Autotuner)
+{
+	typedef util::Autotuner Tuner;
+	Tuner::Space space;
+	space.add("n", { 100000, 10, 1000 });
+	space.add("bad", { 1, 0 });
+	CYBOZU_TEST_EQUAL(space.size(), 6u);
+	CYBOZU_TEST_EXCEPTION(space.add("a b", { 1 }), Xbyak::Error);
+	CYBOZU_TEST_EXCEPTION(space.add("c", {}), Xbyak::Error);
+	int genNum = 0;
+	const Tuner::GenFunc gen = [&](const Tuner::Param& p) {
+		genNum++;
+		if (p.get("bad")) throw Xbyak::Error(ERR_BAD_PARAMETER);
+		return std::make_shared<LoopKernel>(p.get("n"));
+	};
+	const Tuner::WorkFunc work = [](const Xbyak::CodeGenerator& c) { c.getCode<void (*)()>()(); };
+	Tuner tuner;
+	Tuner::Param best;
+	CYBOZU_TEST_ASSERT(tuner.tune(best, "loop", space, gen, work));
+	CYBOZU_TEST_EQUAL(best.get("n"), 10);
+	CYBOZU_TEST_EQUAL(best.get("bad"), 0);
+	CYBOZU_TEST_EQUAL(best.getStr(), "n=10,bad=0");
+	CYBOZU_TEST_EQUAL(genNum, 6);
+	Tuner::Stats st = tuner.getStats();
+	CYBOZU_TEST_EQUAL(st.missNum, 1u);
+	CYBOZU_TEST_EQUAL(st.trialNum, 3u);
+
+	// the search runs once
+	Tuner::Param p;
+	CYBOZU_TEST_ASSERT(tuner.tune(p, "loop", space, gen, work));
+	CYBOZU_TEST_ASSERT(p == best);
+	CYBOZU_TEST_EQUAL(genNum, 6);
+	CYBOZU_TEST_EQUAL(tuner.getStats().hitNum, 1u);
+
+	// the cached parameters out of the space are ignored
+	Tuner::Space space2;
+	space2.add("n", { 1000, 100 });
+	space2.add("bad", { 0 });
+	CYBOZU_TEST_ASSERT(tuner.tune(p, "loop", space2, gen, work));
+	CYBOZU_TEST_EQUAL(p.getStr(), "n=100,bad=0");
+	CYBOZU_TEST_EQUAL(genNum, 8);
+
+	// no candidate
+	Tuner::Space space3;
+	space3.add("bad", { 1 });
+	CYBOZU_TEST_ASSERT(!tuner.tune(p, "bad", space3, gen, work));
+	CYBOZU_TEST_ASSERT(!tuner.getCache(p, "bad"));
+
+	// serialize
+	const std::string str = tuner.getStr();
+	CYBOZU_TEST_EQUAL(str, "loop " + tuner.getCpuKey() + " n=100,bad=0\n");
+	Tuner tuner2;
+	CYBOZU_TEST_ASSERT(tuner2.setStr(str));
+	CYBOZU_TEST_ASSERT(tuner2.getCache(p, "loop"));
+	CYBOZU_TEST_EQUAL(p.getStr(), "n=100,bad=0");
+	CYBOZU_TEST_EQUAL(tuner2.getStr(), str);
+	const char *badTbl[] = { "loop", "loop x", "loop x n", "loop x n=", "loop x n=1,", "loop x =1", " x n=1" };
+	for (size_t i = 0; i < sizeof(badTbl) / sizeof(badTbl[0]); i++) {
+		CYBOZU_TEST_ASSERT(!tuner2.setStr(badTbl[i]));
+	}
+	CYBOZU_TEST_EQUAL(tuner2.getStr(), str);
+
+	// another machine type does not use the cache
+	util::Cpu cpu = util::Cpu::getInstance();
+	cpu.displayModel++;
+	Tuner tuner3(cpu);
+	CYBOZU_TEST_ASSERT(tuner3.getCpuKey() != tuner.getCpuKey());
+	CYBOZU_TEST_ASSERT(tuner3.setStr(str));
+	CYBOZU_TEST_ASSERT(!tuner3.getCache(p, "loop"));
+
+	// the kernel generated with the best parameters
+	Tuner::CodePtr code;
+	genNum = 0;
+	CYBOZU_TEST_ASSERT(tuner3.tune(p, code, "loop", space2, gen, work));
+	CYBOZU_TEST_EQUAL(p.getStr(), "n=100,bad=0");
+	CYBOZU_TEST_EQUAL(genNum, 2);
+	CYBOZU_TEST_ASSERT(code);
+	code->getCode<void (*)()>()();
+	const Tuner::CodePtr prev = code;
+	CYBOZU_TEST_ASSERT(tuner3.tune(p, code, "loop", space2, gen, work));
+	CYBOZU_TEST_EQUAL(p.getStr(), "n=100,bad=0");
+	CYBOZU_TEST_EQUAL(genNum, 3);
+	CYBOZU_TEST_ASSERT(code && code != prev);
+	CYBOZU_TEST_ASSERT(!tuner3.tune(p, code, "bad", space3, gen, work));
+	CYBOZU_TEST_ASSERT(!code);
+	CYBOZU_TEST_EQUAL(genNum, 4);
+
+	// the name is a field of getStr()
+	const char *badNameTbl[] = { "", "a b", "a\nb" };
+	for (size_t i = 0; i < sizeof(badNameTbl) / sizeof(badNameTbl[0]); i++) {
+		CYBOZU_TEST_EXCEPTION(tuner3.tune(p, badNameTbl[i], space2, gen, work), Xbyak::Error);
+		CYBOZU_TEST_EXCEPTION(tuner3.tune(p, code, badNameTbl[i], space2, gen, work), Xbyak::Error);
+	}
+	CYBOZU_TEST_EQUAL(genNum, 4);
+}
+
+// a Cpu which has only the features in type
+static util::Cpu makeCpu(const util::Cpu::Type& type, int avx10version = 0)
+{
+	char buf[128];
+	snprintf(buf, sizeof(buf), "cpu1 %llx %llx 6 a 2 0 b 6 ba 2 10 %x 0 0 0",
+		(unsigned long long)type.getL(), (unsigned long long)type.getH(), avx10version);
+	util::Cpu cpu;
+	CYBOZU_TEST_ASSERT(cpu.setStr(buf));
+	return cpu;
+}
+
+#ifdef __linux__
+// the permission such as "r-x" of the mapping which has p
+static std::string getPerm(const void *p)
+{
+	FILE *fp = fopen("/proc/self/maps", "r");
+	if (fp == 0) return "";
+	std::string ret;
+	char line[512];
+	while (fgets(line, sizeof(line), fp)) {
+		unsigned long long begin, end;
+		char perm[8];
+		if (sscanf(line, "%llx-%llx %7s", &begin, &end, perm) != 3) continue;
+		if (begin <= size_t(p) && size_t(p) < end) {
+			ret.assign(perm, 3);
+			break;
+		}
+	}
+	fclose(fp);
+	return ret;
+}
+#endif
+
+struct AutoGrowKernel : Xbyak::CodeGenerator {
+	AutoGrowKernel(int v, bool re)
+		: Xbyak::CodeGenerator(4096, Xbyak::AutoGrow)
+	{
+		mov(eax, v);
+		ret();
+		if (re) readyRE();
+	}
+};
+
+CYBOZU_TEST_AUTO(Dispatcher)
+{
+	typedef util::Cpu Cpu;
+	typedef util::Dispatcher<int (*)()> Dispatcher;
+	int genNum[5] = {};
+	const Dispatcher::GenFunc gen0 = [&]() { genNum[0]++; return std::make_shared<Kernel>(512); };
+	const Dispatcher::GenFunc gen1 = [&]() { genNum[1]++; return std::make_shared<Kernel>(10); };
+	const Dispatcher::GenFunc gen2 = [&]() { genNum[2]++; return std::make_shared<Kernel>(2); };
+	const Dispatcher::GenFunc gen3 = [&]() { genNum[3]++; return std::make_shared<Kernel>(0); };
+	const Dispatcher::GenFunc bad = [&]() { genNum[4]++; throw Xbyak::Error(ERR_BAD_PARAMETER); return Dispatcher::CodePtr(); };
+	const struct {
+		Cpu::Type type;
+		int avx10version;
+		const char *name;
+		int v;
+	} tbl[] = {
+		{ Cpu::tSSE2 | Cpu::tAVX2 | Cpu::tAVX512F, 0, "avx512", 512 },
+		{ Cpu::tSSE2 | Cpu::tAVX2 | Cpu::tAVX512F, 1, "avx512", 512 },
+		{ Cpu::tSSE2 | Cpu::tAVX2 | Cpu::tAVX10, 2, "avx10", 10 },
+		{ Cpu::tSSE2 | Cpu::tAVX2 | Cpu::tAVX10, 1, "avx2", 2 },
+		{ Cpu::tSSE2 | Cpu::tAVX2, 0, "avx2", 2 },
+		{ Cpu::tSSE2, 0, "generic", 0 },
+	};
+	for (size_t i = 0; i < sizeof(tbl) / sizeof(tbl[0]); i++) {
+		Dispatcher d(makeCpu(tbl[i].type, tbl[i].avx10version));
+		d.add("avx512", Cpu::tAVX512F, gen0);
+		d.add("avx10", Cpu::Type(), gen1, 2);
+		d.add("avx2", Cpu::tAVX2, gen2);
+		d.add("generic", Cpu::Type(), gen3);
+		CYBOZU_TEST_EQUAL(d.getName(), "");
+		int (*f)() = d.get();
+		CYBOZU_TEST_ASSERT(f);
+		CYBOZU_TEST_EQUAL(f(), tbl[i].v);
+		CYBOZU_TEST_EQUAL(d.getName(), tbl[i].name);
+		CYBOZU_TEST_ASSERT(d.get() == f);
+		CYBOZU_TEST_ASSERT(d.isSupported("generic"));
+	}
+	// only the selected variants are generated
+	CYBOZU_TEST_EQUAL(genNum[0], 2);
+	CYBOZU_TEST_EQUAL(genNum[1], 1);
+	CYBOZU_TEST_EQUAL(genNum[2], 2);
+	CYBOZU_TEST_EQUAL(genNum[3], 1);
+
+	// force a variant
+	Dispatcher d(makeCpu(Cpu::tSSE2 | Cpu::tAVX2));
+	d.add("avx512", Cpu::tAVX512F, gen0);
+	d.add("bad", Cpu::Type(), bad);
+	d.add("avx2", Cpu::tAVX2, gen2);
+	d.add("generic", Cpu::Type(), gen3);
+	CYBOZU_TEST_EXCEPTION(d.add("avx2", Cpu::Type(), gen3), Xbyak::Error);
+	CYBOZU_TEST_EXCEPTION(d.add("", Cpu::Type(), gen3), Xbyak::Error);
+	CYBOZU_TEST_EXCEPTION(d.add("null", Cpu::Type(), Dispatcher::GenFunc()), Xbyak::Error);
+	const std::vector<std::string> names = d.getSupportedNames();
+	CYBOZU_TEST_EQUAL(names.size(), 3u);
+	CYBOZU_TEST_EQUAL(names[0], "bad");
+	CYBOZU_TEST_EQUAL(names[1], "avx2");
+	CYBOZU_TEST_EQUAL(names[2], "generic");
+	CYBOZU_TEST_ASSERT(!d.force("avx512"));
+	CYBOZU_TEST_ASSERT(!d.force("unknown"));
+	CYBOZU_TEST_ASSERT(d.force("generic"));
+	int (*f)() = d.get();
+	CYBOZU_TEST_EQUAL(f(), 0);
+	CYBOZU_TEST_EQUAL(d.getName(), "generic");
+	// the address does not change
+	CYBOZU_TEST_ASSERT(d.force(""));
+	CYBOZU_TEST_ASSERT(d.get() == f);
+	CYBOZU_TEST_EQUAL(f(), 2); // "bad" can't be generated
+	CYBOZU_TEST_EQUAL(d.getName(), "avx2");
+	CYBOZU_TEST_ASSERT(!d.force("bad"));
+	CYBOZU_TEST_EQUAL(d.getName(), "avx2");
+	CYBOZU_TEST_ASSERT(d.force("generic"));
+	CYBOZU_TEST_EQUAL(f(), 0);
+	CYBOZU_TEST_EQUAL(genNum[4], 2);
+
+	// no variant
+	Dispatcher d2(makeCpu(Cpu::tSSE2));
+	d2.add("avx512", Cpu::tAVX512F, gen0);
+	CYBOZU_TEST_ASSERT(d2.get() == 0);
+	CYBOZU_TEST_EQUAL(d2.getName(), "");
+
+#if XBYAK_CPU_CACHE == 1
+	// core type preference
+	Dispatcher d3(makeCpu(Cpu::tSSE2 | Cpu::tAVX2));
+	d3.add("avx2", Cpu::tAVX2, gen2);
+	d3.add("avx2-e", Cpu::tAVX2, gen1, 0, util::Efficient);
+	d3.add("generic", Cpu::Type(), gen3);
+	CYBOZU_TEST_EQUAL(d3.getSupportedNames()[0], "avx2");
+	d3.setCoreType(util::Efficient);
+	CYBOZU_TEST_EQUAL(d3.getSupportedNames()[0], "avx2-e");
+	CYBOZU_TEST_EQUAL(d3.get()(), 10);
+	// setCoreType() after get() switches the variant unless it is forced
+	d3.setCoreType(util::Performance);
+	CYBOZU_TEST_EQUAL(d3.getName(), "avx2");
+	CYBOZU_TEST_EQUAL(d3.get()(), 2);
+	CYBOZU_TEST_ASSERT(d3.force("generic"));
+	d3.setCoreType(util::Efficient);
+	CYBOZU_TEST_EQUAL(d3.get()(), 0);
+	CYBOZU_TEST_ASSERT(d3.force(""));
+	CYBOZU_TEST_EQUAL(d3.get()(), 10);
+#endif
+
+	// the protection of AutoGrow kernels and the stub is read/exec
+	Dispatcher d4(makeCpu(Cpu::tSSE2));
+	std::shared_ptr<AutoGrowKernel> k1, k2;
+	d4.add("re", Cpu::Type(), [&]() { k1 = std::make_shared<AutoGrowKernel>(1, true); return k1; });
+	d4.add("notReady", Cpu::Type(), [&]() { k2 = std::make_shared<AutoGrowKernel>(2, false); return k2; });
+	int (*f4)() = d4.get();
+	CYBOZU_TEST_EQUAL(f4(), 1);
+	CYBOZU_TEST_ASSERT(d4.force("notReady"));
+	CYBOZU_TEST_EQUAL(f4(), 2);
+#ifdef __linux__
+	CYBOZU_TEST_EQUAL(getPerm(k1->getCode()), "r-x");
+	CYBOZU_TEST_EQUAL(getPerm(k2->getCode()), "r-x");
+	CYBOZU_TEST_EQUAL(getPerm((const void*)f4), "r-x");
+#endif
+}
+
+CYBOZU_TEST_AUTO(ModuleBuilder)
+{
+	const int n = 100;
+	util::ModuleBuilder mb;
+	// f0() = 1, f<i>() = f<i-1>() + 1
+	for (int i = 0; i < n; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "f%d", i);
+		mb.add(name, [i](util::ModuleBuilder::Func& f) {
+			if (i == 0) {
+				f.mov(f.eax, 1);
+				f.ret();
+				return;
+			}
+			char prev[16];
+			snprintf(prev, sizeof(prev), "f%d", i - 1);
+			f.sub(f.rsp, 8);
+			f.callFunc(prev);
+			f.add(f.eax, 1);
+			f.add(f.rsp, 8);
+			f.ret();
+		});
+	}
+	// absolute address of a label is relocated
+	mb.add("tail", [](util::ModuleBuilder::Func& f) {
+		Label L1;
+		f.mov(f.rax, L1);
+		f.jmp(f.rax);
+		f.nop(5000); // make AutoGrow reallocate the buffer
+		f.L(L1);
+		f.jmpFunc("f9");
+	});
+	CYBOZU_TEST_EXCEPTION(mb.add("f0", [](util::ModuleBuilder::Func& f) { f.ret(); }), Xbyak::Error);
+	mb.build(4);
+	CYBOZU_TEST_EQUAL(mb.getFuncNum(), size_t(n + 1));
+	CYBOZU_TEST_EQUAL(mb.getFunc<int (*)()>("f0")(), 1);
+	CYBOZU_TEST_EQUAL(mb.getFunc<int (*)()>("f99")(), 100);
+	CYBOZU_TEST_EQUAL(mb.getFunc<int (*)()>("tail")(), 10);
+	CYBOZU_TEST_ASSERT(mb.getFunc("none") == 0);
+	for (int i = 0; i < n; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "f%d", i);
+		const uint8_t *p = mb.getFunc(name);
+		CYBOZU_TEST_EQUAL(size_t(p) % 16, 0u);
+		CYBOZU_TEST_ASSERT(mb.getCode() <= p && p < mb.getCode() + mb.getSize());
+	}
+	// rebuild with one thread
+	mb.build(1);
+	CYBOZU_TEST_EQUAL(mb.getFunc<int (*)()>("f99")(), 100);
+}
+
+CYBOZU_TEST_AUTO(ModuleBuilder_error)
+{
+	{
+		util::ModuleBuilder mb;
+		mb.add("f", [](util::ModuleBuilder::Func& f) { f.jmpFunc("none"); });
+		CYBOZU_TEST_EXCEPTION(mb.build(), Xbyak::Error);
+	}
+	{
+		util::ModuleBuilder mb;
+		mb.add("f", [](util::ModuleBuilder::Func& f) { f.jmp("undefined"); });
+		CYBOZU_TEST_EXCEPTION(mb.build(), Xbyak::Error);
+	}
+	{
+		util::ModuleBuilder mb;
+		mb.add("f", [](util::ModuleBuilder::Func& f) { f.ret(); });
+		mb.add("g", [](util::ModuleBuilder::Func&) { throw Xbyak::Error(ERR_BAD_PARAMETER); });
+		CYBOZU_TEST_EXCEPTION(mb.build(2), Xbyak::Error);
+	}
+}
+
+CYBOZU_TEST_AUTO(warmCode)
+{
+	struct Code : Xbyak::CodeGenerator {
+		Code()
+		{
+			mov(eax, 3);
+			nop(1000);
+			ret();
+		}
+	} c;
+	util::warmCode(c.getCode(), c.getSize());
+	CYBOZU_TEST_EQUAL(c.getCode<int (*)()>()(), 3);
+	util::warmCode(c.getCode(), 0);
+}
+
+CYBOZU_TEST_AUTO(CodeManifest)
+{
+	util::CodeManifest m;
+	m.setSize(4096);
+	m.append("f", 0);
+	m.append("g", 128);
+	CYBOZU_TEST_EXCEPTION(m.append("f", 256), Xbyak::Error);
+	CYBOZU_TEST_EXCEPTION(m.append("a b", 256), Xbyak::Error);
+	const std::string s = m.getStr();
+	CYBOZU_TEST_EQUAL(s, "size 4096\nf 0\ng 128\n");
+	util::CodeManifest m2;
+	CYBOZU_TEST_ASSERT(m2.setStr(s));
+	CYBOZU_TEST_EQUAL(m2.getSize(), 4096u);
+	CYBOZU_TEST_EQUAL(m2.getEntryNum(), 2u);
+	CYBOZU_TEST_EQUAL(m2.getOffset("g"), 128u);
+	CYBOZU_TEST_EQUAL(m2.getOffset("h"), size_t(-1));
+	const char *badTbl[] = {
+		"f 0\n", "size 10\nf 10\n", "size 10\nf 1\nf 2\n", "size 10\nf\n", "size 10\nf 1x\n", "size 10\n 1\n",
+	};
+	for (size_t i = 0; i < sizeof(badTbl) / sizeof(badTbl[0]); i++) {
+		CYBOZU_TEST_ASSERT(!m2.setStr(badTbl[i]));
+		CYBOZU_TEST_EQUAL(m2.getEntryNum(), 0u);
+	}
+}
+
+CYBOZU_TEST_AUTO(Clock)
+{
+	const uint64_t hz = util::Clock::getTscHz();
+	CYBOZU_TEST_ASSERT(hz > 100000000); // 100MHz
+	CYBOZU_TEST_EQUAL(util::Clock::getTscHz(), hz);
+	CYBOZU_TEST_NEAR(util::Clock::toNs(hz), 1e9, 1);
+	CYBOZU_TEST_NEAR(util::Clock::toNs(hz / 1000), 1e6, 1);
+	// the calibration is close to the detected frequency
+	const double ratio = util::Clock::calibrateTscHz(20) / double(hz);
+	CYBOZU_TEST_ASSERT(0.9 < ratio && ratio < 1.1);
+	const uint64_t cpuidHz = util::Clock::getTscHzByCpuid();
+	if (cpuidHz && util::Clock::isInvariantTsc()) CYBOZU_TEST_EQUAL(cpuidHz, hz);
+
+	const uint64_t c0 = util::Clock::getRdtscBegin();
+	const uint64_t c1 = util::Clock::getRdtscEnd();
+	CYBOZU_TEST_ASSERT(c1 > c0);
+
+	for (int i = 0; i < 2; i++) {
+		util::Clock clk(i == 1);
+		clk.begin();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		clk.end();
+		CYBOZU_TEST_EQUAL(clk.getCount(), 1);
+		const double ns = clk.getNs();
+		CYBOZU_TEST_ASSERT(19e6 < ns && ns < 1e9);
+	}
+}
+
+CYBOZU_TEST_AUTO(PerfCounter)
+{
+	util::PerfCounter pc;
+	printf("PerfCounter");
+	for (int i = 0; i < util::PerfCounter::TypeNum; i++) {
+		printf(" %s=%d(rdpmc=%d)", util::PerfCounter::getName(i), pc.isAvailable(i), pc.isRdpmc(i));
+	}
+	printf("\n");
+	const int n = 3, loopN = 100000;
+	volatile int x = 0;
+	for (int i = 0; i < n; i++) {
+		pc.begin();
+		pc.begin(1);
+		for (int j = 0; j < loopN; j++) x = x + j;
+		pc.end(1);
+		pc.end();
+	}
+	pc.put("loop");
+	CYBOZU_TEST_EQUAL(pc.getRegionNum(), 2u);
+	CYBOZU_TEST_EQUAL(pc.getCount(), n);
+	CYBOZU_TEST_EQUAL(pc.getCount(1), n);
+	CYBOZU_TEST_EQUAL(pc.getCount(2), 0);
+	CYBOZU_TEST_ASSERT(pc.getResult().clk >= pc.getResult(1).clk);
+	for (int i = 0; i < util::PerfCounter::TypeNum; i++) {
+		if (!pc.isAvailable(i)) {
+			CYBOZU_TEST_EQUAL(pc.get(i), 0u);
+			continue;
+		}
+		// the outer region contains the inner one
+		CYBOZU_TEST_ASSERT(pc.get(i) >= pc.get(i, 1));
+	}
+	if (pc.isAvailable(util::PerfCounter::Instructions)) {
+		CYBOZU_TEST_ASSERT(pc.getResult(1).perCall(util::PerfCounter::Instructions) >= loopN);
+	}
+	pc.clear();
+	CYBOZU_TEST_EQUAL(pc.getRegionNum(), 0u);
+	CYBOZU_TEST_EQUAL(pc.getCount(), 0);
+}
+
+#if defined(__linux__) && defined(XBYAK_USE_MEMFD)
+#include <sys/wait.h>
+
+CYBOZU_TEST_AUTO(SharedCode)
+{
+	struct Code : Xbyak::CodeGenerator {
+		explicit Code(Allocator *alloc)
+			: Xbyak::CodeGenerator(4096, Xbyak::AutoGrow, alloc)
+		{
+			Label f, g;
+			L(f);
+			mov(eax, 3);
+			jmp(g, T_NEAR);
+			align(16);
+			L(g);
+			add(eax, 4);
+			ret();
+		}
+	};
+	MmapAllocator alloc;
+	Code c(&alloc);
+	c.readyRE();
+	CYBOZU_TEST_ASSERT(c.isPositionIndependent());
+	const int fd = alloc.getFd(c.getCode());
+	CYBOZU_TEST_ASSERT(fd >= 0);
+	util::CodeManifest m;
+	m.setSize(c.getSize());
+	m.append("f", 0);
+	m.append("g", 16);
+	const std::string manifest = m.getStr();
+
+	const pid_t pid = fork();
+	if (pid == 0) {
+		// child
+		util::CodeManifest cm;
+		if (!cm.setStr(manifest)) _exit(1);
+		util::SharedCode sc(fd, cm.getSize());
+		int (*f)() = sc.getCode<int (*)()>(cm.getOffset("f"));
+		_exit(f());
+	}
+	CYBOZU_TEST_ASSERT(pid > 0);
+	int status = 0;
+	CYBOZU_TEST_EQUAL(waitpid(pid, &status, 0), pid);
+	CYBOZU_TEST_ASSERT(WIFEXITED(status));
+	CYBOZU_TEST_EQUAL(WEXITSTATUS(status), 7);
+
+	util::SharedCode sc(fd, c.getSize());
+	CYBOZU_TEST_ASSERT(sc.getCode() != c.getCode());
+	CYBOZU_TEST_EQUAL(sc.getCode<int (*)()>(m.getOffset("f"))(), 7);
+}
+
+CYBOZU_TEST_AUTO(isPositionIndependent)
+{
+	struct Code : Xbyak::CodeGenerator {
+		explicit Code(bool useAbs)
+			: Xbyak::CodeGenerator(4096, Xbyak::AutoGrow)
+		{
+			Label L1;
+			if (useAbs) mov(rax, L1);
+			L(L1);
+			ret();
+		}
+	};
+	CYBOZU_TEST_ASSERT(Code(false).isPositionIndependent());
+	CYBOZU_TEST_ASSERT(!Code(true).isPositionIndependent());
+	CYBOZU_TEST_ASSERT(!Xbyak::CodeGenerator().isPositionIndependent());
+}
+#endif
+
+CYBOZU_TEST_AUTO(Microbench)
+{
+	util::Microbench mb;
+	mb.setRepeatN(5);
+	// imul r, r has latency 3 and throughput 1
+	const util::Microbench::Body imul = [](CodeGenerator& c, int idx) {
+		static const int tbl[] = { 0, 1, 2, 3, 6, 7, 8, 9 };
+		const Reg64 r(tbl[idx]);
+		c.imul(r, r);
+	};
+	mb.setUnroll(8);
+	util::Microbench::Result lat, tp;
+	CYBOZU_TEST_ASSERT(mb.measure(lat, imul, util::Microbench::Latency));
+	CYBOZU_TEST_ASSERT(mb.measure(tp, imul, util::Microbench::Throughput));
+	CYBOZU_TEST_ASSERT(lat.loopN > 0);
+	CYBOZU_TEST_ASSERT(lat.stddev >= 0);
+	CYBOZU_TEST_ASSERT(lat.min <= lat.mean);
+	CYBOZU_TEST_ASSERT(tp.loopN > 0);
+	CYBOZU_TEST_ASSERT(tp.min <= tp.mean);
+	// TSC is not stable enough (frequency scaling, noisy neighbors) to compare the results
+	if (lat.byPmu) {
+		CYBOZU_TEST_ASSERT(lat.mean > tp.mean * 1.5);
+		CYBOZU_TEST_ASSERT(lat.mean > 2.5);
+	}
+
+	// the body can use the callee-saved registers
+	util::Microbench::Result r;
+	CYBOZU_TEST_ASSERT(mb.measure(r, [](CodeGenerator& c, int) {
+		c.xor_(c.rbx, c.rbx);
+		c.xor_(c.r12, c.r12);
+		c.pxor(c.xmm6, c.xmm6);
+	}));
+	CYBOZU_TEST_EQUAL(mb.getUnroll(), 8);
+
+#if XBYAK_CPU_CACHE == 1
+	util::CpuMask org;
+	CYBOZU_TEST_ASSERT(util::getAffinity(org));
+	mb.setCpu(int(*org.begin()));
+	CYBOZU_TEST_ASSERT(mb.measure(r, imul));
+	util::CpuMask cur;
+	CYBOZU_TEST_ASSERT(util::getAffinity(cur));
+	CYBOZU_TEST_ASSERT(cur == org);
+	mb.setCpu(1000); // not available
+	CYBOZU_TEST_ASSERT(!mb.measure(r, imul));
+#endif
+}
+
+#if XBYAK_CPU_CACHE == 1
+CYBOZU_TEST_AUTO(ThreadPool)
+{
+	util::CpuTopology topo(util::Cpu::getInstance());
+	util::ThreadPool pool(topo);
+	const size_t threadNum = pool.getThreadNum();
+	CYBOZU_TEST_ASSERT(threadNum > 0);
+	CYBOZU_TEST_EQUAL(pool.getWorkerIdx(), -1);
+	std::atomic<int> sum(0);
+	std::atomic<int> badIdx(0);
+	const int n = 1000;
+	for (int i = 0; i < n; i++) {
+		pool.submit([&, i]() {
+			if (pool.getWorkerIdx() < 0) badIdx++;
+			sum += i;
+		});
+	}
+	pool.wait();
+	CYBOZU_TEST_EQUAL(sum, n * (n - 1) / 2);
+	CYBOZU_TEST_EQUAL(badIdx, 0);
+	uint64_t taskNum = 0;
+	for (size_t i = 0; i < threadNum; i++) taskNum += pool.getStats(i).taskNum;
+	CYBOZU_TEST_EQUAL(taskNum, uint64_t(n));
+
+	// tasks submitted by a task
+	sum = 0;
+	for (int i = 0; i < 10; i++) {
+		pool.submit([&]() {
+			for (int j = 0; j < 10; j++) pool.submit([&]() { sum++; });
+		});
+	}
+	pool.wait();
+	CYBOZU_TEST_EQUAL(sum, 100);
+
+	std::vector<int> v(12345);
+	pool.parallelFor(v.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) v[i]++;
+	});
+	for (size_t i = 0; i < v.size(); i++) {
+		CYBOZU_TEST_EQUAL(v[i], 1);
+	}
+	pool.parallelFor(v.size(), [&](size_t begin, size_t end) {
+		CYBOZU_TEST_ASSERT(end - begin >= 1000 || end == v.size());
+		for (size_t i = begin; i < end; i++) v[i]++;
+	}, 1000);
+	for (size_t i = 0; i < v.size(); i++) {
+		CYBOZU_TEST_EQUAL(v[i], 2);
+	}
+}
+
+CYBOZU_TEST_AUTO(ThreadPool_exception)
+{
+	util::CpuTopology topo(util::Cpu::getInstance());
+	util::ThreadPool pool(topo, 2);
+	std::atomic<int> sum(0);
+	for (int i = 0; i < 10; i++) {
+		pool.submit([&, i]() {
+			if (i == 3) throw std::runtime_error("task");
+			sum++;
+		});
+	}
+	CYBOZU_TEST_EXCEPTION(pool.wait(), std::runtime_error);
+	CYBOZU_TEST_EQUAL(sum, 9);
+	// the pool is still available
+	pool.submit([&]() { sum++; });
+	pool.wait();
+	CYBOZU_TEST_EQUAL(sum, 10);
+}
+
+CYBOZU_TEST_AUTO(ThreadPool_parallelFor)
+{
+	util::CpuTopology topo(util::Cpu::getInstance());
+	util::ThreadPool pool(topo);
+	// parallelFor in a task waits only for its ranges and runs them by itself if necessary
+	std::atomic<int> sum(0);
+	pool.parallelFor(8, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			pool.parallelFor(100, [&](size_t b, size_t e) { sum += int(e - b); });
+		}
+	});
+	CYBOZU_TEST_EQUAL(sum, 800);
+
+	// an exception is rethrown only to the caller whose f threw it
+	std::atomic<int> other(0);
+	std::thread t([&]() {
+		for (int i = 0; i < 100; i++) {
+			pool.parallelFor(10, [&](size_t begin, size_t end) { other += int(end - begin); });
+		}
+	});
+	CYBOZU_TEST_EXCEPTION(pool.parallelFor(10, [](size_t, size_t) { throw std::runtime_error("range"); }), std::runtime_error);
+	t.join();
+	CYBOZU_TEST_EQUAL(other, 1000);
+	CYBOZU_TEST_NO_EXCEPTION(pool.wait());
+}
+
+CYBOZU_TEST_AUTO(ThreadPool_destructor)
+{
+	// the destructor finishes all tasks
+	std::atomic<int> sum(0);
+	{
+		util::CpuTopology topo(util::Cpu::getInstance());
+		util::ThreadPool pool(topo);
+		for (int i = 0; i < 100; i++) pool.submit([&]() { sum++; });
+	}
+	CYBOZU_TEST_EQUAL(sum, 100);
+}
+#endif
@@ -147,14 +147,29 @@
 // g++-6 or later
 #if ((__cplusplus >= 201402L) && !(!defined(__clang__) && defined(__GNUC__) && (__GNUC__ <= 5))) || (defined(_MSC_VER) && _MSC_VER >= 1910)
 	#define XBYAK_CONSTEXPR constexpr
+	#define XBYAK_CONSTEXPR14
 #else
 	#define XBYAK_CONSTEXPR
 #endif
 
-#ifdef __cpp_inline_variables
+/*
+	registers of CodeGenerator are static constexpr members (C++14 or later)
+	define XBYAK_NO_CONSTEXPR_REGISTERS to make them non-static members as before
+*/
+#if !defined(XBYAK_NO_CONSTEXPR_REGISTERS) && (defined(XBYAK_CONSTEXPR14) || defined(__cpp_inline_variables))
 	#define XBYAK_USE_CONSTEXPR_REGISTERS 1
 #endif
 
+// XBYAK_USE_METRICS requires C++11
+#ifdef XBYAK_USE_METRICS
+	#include <chrono>
+	#include <mutex>
+	#include <deque>
+	#ifdef _MSC_VER
+		#include <intrin.h> // for __rdtsc
+	#endif
+#endif
+
 #ifdef _MSC_VER
 	#pragma warning(push)
 	#pragma warning(disable : 4514) /* remove inline function */
@@ -1014,8 +1029,17 @@ inline int getMacOsVersion()
 } // util
 #endif
 class MmapAllocator : public Allocator {
+public:
+	struct Stats {
+		size_t liveBytes; // total size of the live allocations
+		size_t peakBytes; // max of liveBytes
+		size_t liveCount; // the number of the live allocations
+		size_t allocCount; // the number of calls of alloc()
+		size_t memfdCount; // the number of the open memfds
+		Stats() : liveBytes(0), peakBytes(0), liveCount(0), allocCount(0), memfdCount(0) {}
+	};
+private:
 	struct Allocation {
-		uintptr_t addr;
 		size_t size;
 #if defined(XBYAK_USE_MEMFD)
 		// fd_ is only used with XBYAK_USE_MEMFD. We keep the file open
@@ -1025,10 +1049,88 @@ class MmapAllocator : public Allocator {
 #endif
 	};
 	const std::string name_; // only used with XBYAK_USE_MEMFD
-	typedef std::vector<Allocation> AllocationList;
+	typedef XBYAK_STD_UNORDERED_MAP<uintptr_t, Allocation> AllocationList; // key is the address
 	AllocationList allocList_;
+	Stats stats_;
+	uintptr_t nearAddr_; // see setNearAddr()
+	bool populate_; // see setPopulate()
+	bool lock_; // see setLock()
+#ifdef __linux__
+	/*
+		map size bytes at a free gap in /proc/self/maps within +-2GiB of anchor
+		candidates nearer to anchor are tried first
+	*/
+	static void *mmapNear(uintptr_t anchor, size_t size, int prot, int mode, int fd)
+	{
+		const uint64_t range = 0x7fff0000; // slightly less than 2GiB
+		const size_t pageSize = inner::getPageSize();
+		const uint64_t lo = (std::max<uint64_t>)(anchor > range ? anchor - range : 0, pageSize * 16);
+		const uint64_t hi = uint64_t(anchor) + range;
+		FILE *fp = fopen("/proc/self/maps", "r");
+		if (fp == 0) return MAP_FAILED;
+		std::vector<std::pair<uint64_t, uint64_t> > candList; // (distance, addr)
+		uint64_t prevEnd = 0;
+		for (;;) {
+			unsigned long begin, end;
+			const int n = fscanf(fp, "%lx-%lx%*[^\n]\n", &begin, &end);
+			// the last gap is [prevEnd, hi) ; lo may not be page-aligned, so round up gapBegin for MAP_FIXED_NOREPLACE
+			const uint64_t gapBegin = ((std::max<uint64_t>)(prevEnd, lo) + pageSize - 1) & ~uint64_t(pageSize - 1);
+			const uint64_t gapEnd = (std::min<uint64_t>)(n == 2 ? begin : hi, hi);
+			if (gapBegin < gapEnd && gapEnd - gapBegin >= size) {
+				// the address nearest to anchor in the gap
+				uint64_t addr = gapBegin;
+				if (gapEnd <= anchor) {
+					addr = (gapEnd - size) & ~uint64_t(pageSize - 1);
+				} else if (gapBegin < anchor) {
+					addr = (anchor - size / 2) & ~uint64_t(pageSize - 1);
+					if (addr < gapBegin) addr = gapBegin;
+					if (addr + size > gapEnd) addr = (gapEnd - size) & ~uint64_t(pageSize - 1);
+				}
+				const uint64_t dist = addr < anchor ? anchor - addr : addr + size - anchor;
+				candList.push_back(std::make_pair(dist, addr));
+			}
+			if (n != 2 || end >= hi) break;
+			prevEnd = end;
+		}
+		fclose(fp);
+		std::sort(candList.begin(), candList.end());
+#ifdef MAP_FIXED_NOREPLACE
+		mode |= MAP_FIXED_NOREPLACE;
+#endif
+		for (size_t i = 0; i < candList.size(); i++) {
+			void *hint = (void*)(uintptr_t)candList[i].second;
+			void *p = mmap(hint, size, prot, mode, fd, 0);
+			if (p == hint) return p;
+			// the kernel may treat the address as a hint and map another place
+			if (p != MAP_FAILED) munmap(p, size);
+		}
+		return MAP_FAILED;
+	}
+#endif
 public:
-	explicit MmapAllocator(const std::string& name = "xbyak") : name_(name) {}
+	explicit MmapAllocator(const std::string& name = "xbyak") : name_(name), nearAddr_(0), populate_(false), lock_(false) {}
+	// prefault the pages in alloc() (MAP_POPULATE on Linux) to avoid page faults at the first call
+	void setPopulate(bool populate) { populate_ = populate; }
+	/*
+		lock the pages in memory by mlock() in alloc() to avoid swapping them out
+		it is ignored if mlock() fails (see RLIMIT_MEMLOCK)
+	*/
+	void setLock(bool lock) { lock_ = lock; }
+	/*
+		allocate memory within +-2GiB of anchor (e.g. a function in the main executable or libc)
+		so that the generated code can call the functions around anchor by `call rel32`
+		alloc() throws ERR_CANT_ALLOC if there is no free space
+		anchor = 0 disables it (default)
+		@note Linux only
+	*/
+	void setNearAddr(const void *anchor)
+	{
+#ifdef __linux__
+		nearAddr_ = (uintptr_t)anchor;
+#else
+		if (anchor) XBYAK_THROW(ERR_NOT_SUPPORTED)
+#endif
+	}
 	uint8_t *alloc(size_t size) XBYAK_OVERRIDE
 	{
 		const size_t alignedSizeM1 = inner::getPageSize() - 1;
@@ -1054,6 +1156,9 @@ public:
 				XBYAK_THROW_RET(ERR_CANT_ALLOC, 0)
 			}
 		}
+#endif
+#ifdef MAP_POPULATE
+		if (populate_) mode |= MAP_POPULATE;
 #endif
 		int prot = PROT_READ | PROT_WRITE;
 #ifdef PROT_MPROTECT
@@ -1061,37 +1166,68 @@ public:
 		// https://man.netbsd.org/mprotect.2
 		prot |= PROT_MPROTECT(PROT_READ | PROT_WRITE | PROT_EXEC);
 #endif
+#ifdef __linux__
+		void *p = nearAddr_ ? mmapNear(nearAddr_, size, prot, mode, fd) : mmap(NULL, size, prot, mode, fd, 0);
+#else
 		void *p = mmap(NULL, size, prot, mode, fd, 0);
+#endif
 		if (p == MAP_FAILED) {
 			if (fd != -1) close(fd);
 			XBYAK_THROW_RET(ERR_CANT_ALLOC, 0)
 		}
 		assert(p);
+#ifndef MAP_POPULATE
+		if (populate_) {
+			const size_t pageSize = inner::getPageSize();
+			for (size_t i = 0; i < size; i += pageSize) static_cast<volatile uint8_t*>(p)[i] = 0;
+		}
+#endif
+		if (lock_) mlock(p, size);
 		Allocation alloc;
-		alloc.addr = (uintptr_t)p;
 		alloc.size = size;
 #if defined(XBYAK_USE_MEMFD)
 		alloc.fd = fd;
 #endif
-		allocList_.push_back(alloc);
+		allocList_.insert(AllocationList::value_type((uintptr_t)p, alloc));
+		stats_.liveBytes += size;
+		if (stats_.liveBytes > stats_.peakBytes) stats_.peakBytes = stats_.liveBytes;
+		stats_.liveCount++;
+		stats_.allocCount++;
+		if (fd != -1) stats_.memfdCount++;
 		return (uint8_t*)p;
 	}
+	/*
+		return the memfd of the memory p allocated by alloc() (-1 if XBYAK_USE_MEMFD is not defined)
+		another process can map the code with util::SharedCode
+	*/
+	int getFd(const uint8_t *p) const
+	{
+#if defined(XBYAK_USE_MEMFD)
+		AllocationList::const_iterator i = allocList_.find((uintptr_t)p);
+		if (i != allocList_.end()) return i->second.fd;
+#else
+		(void)p;
+#endif
+		return -1;
+	}
 	void free(uint8_t *p) XBYAK_OVERRIDE
 	{
 		if (p == 0) return;
-		for (size_t idx = 0; idx < allocList_.size(); idx++) {
-			Allocation& a = allocList_[idx];
-			if (a.addr != (uintptr_t)p) continue;
-			if (munmap((void*)a.addr, a.size) < 0) XBYAK_THROW(ERR_MUNMAP)
+		AllocationList::iterator i = allocList_.find((uintptr_t)p);
+		if (i == allocList_.end()) XBYAK_THROW(ERR_BAD_PARAMETER)
+		const Allocation& a = i->second;
+		if (munmap((void*)p, a.size) < 0) XBYAK_THROW(ERR_MUNMAP)
 #if defined(XBYAK_USE_MEMFD)
-			if (a.fd != -1) close(a.fd);
-#endif
-			a = allocList_.back();
-			allocList_.pop_back();
-			return;
+		if (a.fd != -1) {
+			close(a.fd);
+			stats_.memfdCount--;
 		}
-		XBYAK_THROW(ERR_BAD_PARAMETER)
+#endif
+		stats_.liveBytes -= a.size;
+		stats_.liveCount--;
+		allocList_.erase(i);
 	}
+	const Stats& getStats() const { return stats_; }
 };
 #else
 typedef Allocator MmapAllocator;
@@ -1691,6 +1827,118 @@ inline RegExp operator-(const RegExp& e, size_t disp)
 	return ret;
 }
 
+#ifdef XBYAK_USE_METRICS
+/*
+	cost of a CodeGenerator from construction (or reset()) to ready()
+*/
+struct Metrics {
+	uint64_t genNs; // wall-clock time in nsec
+	uint64_t genTsc; // rdtsc count
+	size_t codeBytes; // code size
+	size_t insnNum; // the number of instructions (prefixes such as lock() are not counted)
+	size_t labelNum; // the number of defined labels
+	size_t growNum; // the number of reallocations in AutoGrow mode
+	size_t protectNum; // the number of calls of setProtectMode()
+	size_t allocBytes; // bytes allocated for the code
+	Metrics() : genNs(0), genTsc(0), codeBytes(0), insnNum(0), labelNum(0), growNum(0), protectNum(0), allocBytes(0) {}
+	void add(const Metrics& rhs)
+	{
+		genNs += rhs.genNs;
+		genTsc += rhs.genTsc;
+		codeBytes += rhs.codeBytes;
+		insnNum += rhs.insnNum;
+		labelNum += rhs.labelNum;
+		growNum += rhs.growNum;
+		protectNum += rhs.protectNum;
+		allocBytes += rhs.allocBytes;
+	}
+};
+
+/*
+	process-wide registry of Metrics
+	it keeps the total and the latest records
+*/
+class MetricsRegistry {
+	mutable std::mutex m_;
+	Metrics total_;
+	size_t count_;
+	std::deque<Metrics> recordList_;
+	size_t maxRecordNum_;
+	MetricsRegistry() : count_(0), maxRecordNum_(1024) {}
+	MetricsRegistry(const MetricsRegistry&);
+	void operator=(const MetricsRegistry&);
+public:
+	static MetricsRegistry& getInstance()
+	{
+		static MetricsRegistry instance;
+		return instance;
+	}
+	void append(const Metrics& metrics)
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		total_.add(metrics);
+		count_++;
+		if (maxRecordNum_ == 0) return;
+		if (recordList_.size() >= maxRecordNum_) recordList_.pop_front();
+		recordList_.push_back(metrics);
+	}
+	// the sum of all metrics appended so far
+	Metrics getTotal() const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		return total_;
+	}
+	// the number of metrics appended so far
+	size_t getCount() const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		return count_;
+	}
+	// copy of the latest records (older first)
+	std::vector<Metrics> getRecords() const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		return std::vector<Metrics>(recordList_.begin(), recordList_.end());
+	}
+	// call f(const Metrics&) for each latest record (older first) with the lock held
+	template<class F>
+	void forEach(F f) const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		for (std::deque<Metrics>::const_iterator i = recordList_.begin(), ie = recordList_.end(); i != ie; ++i) f(*i);
+	}
+	// the number of the latest records to keep (default 1024)
+	void setMaxRecordNum(size_t n)
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		maxRecordNum_ = n;
+		while (recordList_.size() > maxRecordNum_) recordList_.pop_front();
+	}
+	void clear()
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		total_ = Metrics();
+		count_ = 0;
+		recordList_.clear();
+	}
+};
+
+namespace inner {
+
+inline uint64_t getRdtsc()
+{
+#ifdef _MSC_VER
+	return __rdtsc();
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("rdtsc" : "=a"(eax), "=d"(edx));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+} // inner
+#endif // XBYAK_USE_METRICS
+
 // 2nd parameter for constructor of CodeArray(maxSize, userPtr, alloc)
 void *const AutoGrow = (void*)1; //-V566
 void *const DontSetProtectRWE = (void*)2; //-V566
@@ -1730,7 +1978,40 @@ protected:
 	size_t maxSize_;
 	uint8_t *top_;
 	size_t size_;
+	size_t limit_; // db() writes code in [0, limit_)
+	size_t coldTop_; // offset of the cold section (maxSize_ if it is not reserved)
+	size_t otherSize_; // size_ of the inactive (hot or cold) section
+	size_t tailTop_; // offset of the data put at the end of the hot section by reserveTail() (coldTop_ if none)
+	bool isCold_;
 	bool isCalledCalcJmpAddress_;
+#ifdef XBYAK_USE_METRICS
+	Metrics metrics_;
+	std::chrono::steady_clock::time_point metricsBegin_;
+	uint64_t metricsBeginTsc_;
+	bool isMetricsRecorded_;
+	void beginMetrics()
+	{
+		const size_t allocBytes = metrics_.allocBytes;
+		metrics_ = Metrics();
+		metrics_.allocBytes = allocBytes;
+		metricsBegin_ = std::chrono::steady_clock::now();
+		metricsBeginTsc_ = inner::getRdtsc();
+		isMetricsRecorded_ = false;
+	}
+	void endMetrics()
+	{
+		if (isMetricsRecorded_) return;
+		metrics_.genTsc = inner::getRdtsc() - metricsBeginTsc_;
+		metrics_.genNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - metricsBegin_).count();
+		metrics_.codeBytes = size_ + getColdSize();
+		MetricsRegistry::getInstance().append(metrics_);
+		isMetricsRecorded_ = true;
+	}
+	// called once per instruction by the encoders
+	void countInsn() { metrics_.insnNum++; }
+#else
+	void countInsn() {}
+#endif
 
 	bool useProtect() const { return alloc_->useProtect(); }
 	/*
@@ -1745,6 +2026,11 @@ protected:
 		alloc_->free(top_);
 		top_ = newTop;
 		maxSize_ = newSize;
+		limit_ = coldTop_ = otherSize_ = tailTop_ = newSize; // the cold section is not supported in AutoGrow mode
+#ifdef XBYAK_USE_METRICS
+		metrics_.growNum++;
+		metrics_.allocBytes += newSize;
+#endif
 	}
 	/*
 		calc jmp address for AutoGrow mode
@@ -1758,6 +2044,18 @@ protected:
 		}
 		isCalledCalcJmpAddress_ = true;
 	}
+	/*
+		reserve size bytes at the end of the free space of the hot section and return its offset
+		the hot code can't grow over the reserved bytes (not for AutoGrow mode)
+	*/
+	size_t reserveTail(size_t size)
+	{
+		const size_t hotSize = isCold_ ? otherSize_ : size_;
+		if (tailTop_ < hotSize + size) XBYAK_THROW_RET(ERR_CODE_IS_TOO_BIG, 0)
+		tailTop_ -= size;
+		if (!isCold_) limit_ = tailTop_;
+		return tailTop_;
+	}
 public:
 	enum ProtectMode {
 		PROTECT_RW = 0, // read/write
@@ -1773,9 +2071,18 @@ public:
 		, maxSize_(maxSize)
 		, top_(type_ == USER_BUF ? reinterpret_cast<uint8_t*>(userPtr) : alloc_->alloc((std::max<size_t>)(maxSize, 1)))
 		, size_(0)
+		, limit_(maxSize)
+		, coldTop_(maxSize)
+		, otherSize_(maxSize)
+		, tailTop_(maxSize)
+		, isCold_(false)
 		, isCalledCalcJmpAddress_(false)
 		, curMode_(PROTECT_RW)
 	{
+#ifdef XBYAK_USE_METRICS
+		beginMetrics();
+		if (isAllocType() && top_) metrics_.allocBytes = maxSize_;
+#endif
 		if (maxSize_ > 0 && top_ == 0) XBYAK_THROW(ERR_CANT_ALLOC)
 		if ((type_ == ALLOC_BUF && userPtr != DontSetProtectRWE && useProtect()) && !setProtectMode(PROTECT_RWE, false)) {
 			alloc_->free(top_);
@@ -1784,6 +2091,10 @@ public:
 	}
 	virtual ~CodeArray()
 	{
+#ifdef XBYAK_USE_METRICS
+		// record the generator which did not call ready()
+		endMetrics();
+#endif
 		if (isAllocType()) {
 			if (useProtect()) setProtectModeRW(false);
 			alloc_->free(top_);
@@ -1791,6 +2102,9 @@ public:
 	}
 	bool setProtectMode(ProtectMode mode, bool throwException = true)
 	{
+#ifdef XBYAK_USE_METRICS
+		metrics_.protectNum++;
+#endif
 		bool isOK = protect(top_, maxSize_, mode);
 		if (isOK) {
 			curMode_ = mode;
@@ -1804,12 +2118,50 @@ public:
 	void resetSize()
 	{
 		size_ = 0;
+		limit_ = coldTop_;
+		otherSize_ = coldTop_;
+		tailTop_ = coldTop_;
+		isCold_ = false;
 		addrInfoList_.clear();
 		isCalledCalcJmpAddress_ = false;
 	}
+	/*
+		reserve the last coldSize bytes of the buffer for cold code (error paths, slow paths, ...)
+		the cold section starts at a 64-byte aligned address and hot code must fit in front of it
+		@note not supported in AutoGrow mode
+	*/
+	void setColdSection(size_t coldSize)
+	{
+		if (isAutoGrow() || isCold_ || getColdSize() > 0 || tailTop_ != coldTop_ || coldSize > maxSize_) XBYAK_THROW(ERR_BAD_PARAMETER)
+		size_t coldTop = maxSize_ - coldSize;
+		const size_t adj = (size_t(top_) + coldTop) & 63;
+		if (coldTop < size_ + adj) XBYAK_THROW(ERR_CODE_IS_TOO_BIG)
+		coldTop -= adj;
+		limit_ = coldTop_ = otherSize_ = tailTop_ = coldTop;
+	}
+	// emit the following code into the cold section
+	void switchToCold()
+	{
+		if (isCold_) return;
+		if (coldTop_ == maxSize_) XBYAK_THROW(ERR_BAD_PARAMETER)
+		std::swap(size_, otherSize_);
+		limit_ = maxSize_;
+		isCold_ = true;
+	}
+	// emit the following code into the hot section
+	void switchToHot()
+	{
+		if (!isCold_) return;
+		std::swap(size_, otherSize_);
+		limit_ = tailTop_;
+		isCold_ = false;
+	}
+	bool isCold() const { return isCold_; }
+	const uint8_t *getColdCode() const { return top_ + coldTop_; }
+	size_t getColdSize() const { return (isCold_ ? size_ : otherSize_) - coldTop_; }
 	void db(int code)
 	{
-		if (size_ >= maxSize_) {
+		if (size_ >= limit_) {
 			if (type_ == AUTO_GROW) {
 				growMemory();
 			} else {
@@ -1840,7 +2192,7 @@ public:
 	size_t getSize() const { return size_; }
 	void setSize(size_t size)
 	{
-		if (size > maxSize_) XBYAK_THROW(ERR_OFFSET_IS_TOO_BIG)
+		if (size > limit_) XBYAK_THROW(ERR_OFFSET_IS_TOO_BIG)
 		size_ = size;
 	}
 	void dump() const
@@ -1884,7 +2236,63 @@ public:
 		addrInfoList_.push_back(AddrInfo(offset, val, size, mode));
 	}
 	bool isAutoGrow() const { return type_ == AUTO_GROW; }
+	/*
+		copy the code to dst and fix the address-dependent fields as if the code were placed at addr (dst if addr = 0)
+		@note only for AutoGrow mode because the other modes do not record these fields
+	*/
+	void copyTo(uint8_t *dst, const uint8_t *addr = 0) const
+	{
+		if (!isAutoGrow()) XBYAK_THROW(ERR_BAD_PARAMETER)
+		if (addr == 0) addr = dst;
+		for (size_t i = 0; i < size_; i++) dst[i] = top_[i];
+		for (AddrInfoList::const_iterator i = addrInfoList_.begin(), ie = addrInfoList_.end(); i != ie; ++i) {
+			const uint64_t disp = i->getVal(addr);
+			for (int j = 0; j < i->jmpSize; j++) {
+				dst[i->codeOffset + j] = static_cast<uint8_t>(disp >> (j * 8));
+			}
+		}
+	}
+	/*
+		FNV-1a hash of the code and the address-dependent fields
+		it does not depend on the address of the code (AutoGrow mode only)
+	*/
+	uint64_t getCodeHash() const
+	{
+		if (!isAutoGrow()) XBYAK_THROW_RET(ERR_BAD_PARAMETER, 0)
+		std::vector<uint8_t> buf(top_, top_ + size_);
+		for (AddrInfoList::const_iterator i = addrInfoList_.begin(), ie = addrInfoList_.end(); i != ie; ++i) {
+			for (int j = 0; j < i->jmpSize; j++) buf[i->codeOffset + j] = 0;
+		}
+		const uint64_t prime = uint64_t(0x100000001b3ull);
+		uint64_t h = uint64_t(0xcbf29ce484222325ull);
+		for (size_t i = 0; i < buf.size(); i++) {
+			h = (h ^ buf[i]) * prime;
+		}
+		for (AddrInfoList::const_iterator i = addrInfoList_.begin(), ie = addrInfoList_.end(); i != ie; ++i) {
+			const uint64_t v[] = { i->codeOffset, i->jmpAddr, uint64_t(i->jmpSize), uint64_t(i->mode) };
+			for (size_t j = 0; j < sizeof(v) / sizeof(v[0]); j++) {
+				for (int k = 0; k < 8; k++) h = (h ^ uint8_t(v[j] >> (k * 8))) * prime;
+			}
+		}
+		return h;
+	}
+	/*
+		return true if the code works at any address
+		the other modes than AutoGrow always return false because they do not record address-dependent fields
+	*/
+	bool isPositionIndependent() const
+	{
+		if (!isAutoGrow()) return false;
+		for (AddrInfoList::const_iterator i = addrInfoList_.begin(), ie = addrInfoList_.end(); i != ie; ++i) {
+			if (i->mode != inner::LasIs) return false;
+		}
+		return true;
+	}
 	bool isAllocType() const { return type_ == ALLOC_BUF || type_ == AUTO_GROW; }
+#ifdef XBYAK_USE_METRICS
+	// metrics of this generator (genNs, genTsc, and codeBytes are set by ready())
+	const Metrics& getMetrics() const { return metrics_; }
+#endif
 	bool isCalledCalcJmpAddress() const { return isCalledCalcJmpAddress_; }
 	/**
 		change exec permission of memory
@@ -2354,7 +2762,34 @@ typedef enum {
 	AVX10v2Encoding
 } PreferredEncoding;
 
+#ifdef XBYAK_USE_CONSTEXPR_REGISTERS
+namespace inner {
+
+/*
+	static constexpr registers of CodeGenerator
+	a class template allows the definitions out of the class in a header before C++17
+*/
+template<class T = void>
+struct RegistersT {
+	#define XBYAK_DEFINE_REGISTER(Type, name, ...) static constexpr Type name{__VA_ARGS__};
+	XBYAK_FOR_EACH_REGISTER(XBYAK_DEFINE_REGISTER)
+	XBYAK_FOR_EACH_CONVENIENCE_ALL(XBYAK_DEFINE_REGISTER)
+	#undef XBYAK_DEFINE_REGISTER
+};
+
+#ifndef __cpp_inline_variables
+	#define XBYAK_DEFINE_REGISTER(Type, name, ...) template<class T> constexpr Type RegistersT<T>::name;
+	XBYAK_FOR_EACH_REGISTER(XBYAK_DEFINE_REGISTER)
+	XBYAK_FOR_EACH_CONVENIENCE_ALL(XBYAK_DEFINE_REGISTER)
+	#undef XBYAK_DEFINE_REGISTER
+#endif
+
+} // inner
+
+class CodeGenerator : public CodeArray, public inner::RegistersT<> {
+#else
 class CodeGenerator : public CodeArray {
+#endif
 public:
 	enum LabelType {
 		T_SHORT,
@@ -2548,6 +2983,7 @@ private:
 			uint32_t mmmm = getMap(type);
 			db(0xC4); db((r ? 0 : 0x80) | (x ? 0 : 0x40) | (b ? 0 : 0x20) | mmmm); db((w << 7) | vvvv);
 		}
+		countInsn();
 		db(code);
 	}
 	void verifySAE(const Reg& r, uint64_t type) const
@@ -2620,6 +3056,7 @@ private:
 		db((R ? 0 : 0x80) | (X3 ? 0 : 0x40) | (B ? 0 : 0x20) | (Rp ? 0 : 0x10) | B4 | mmm);
 		db((w == 1 ? 0x80 : 0) | ((vvvv & 15) << 3) | U | (pp & 3));
 		db((z ? 0x80 : 0) | ((LL & 3) << 5) | (b ? 0x10 : 0) | (V4 ? 0 : 8) | (aaa & 7));
+		countInsn();
 		db(code);
 		return disp8N;
 	}
@@ -2738,6 +3175,7 @@ private:
 				db(0x0F); db(0x3A);
 			}
 		}
+		countInsn();
 		db(code | (((type & T_SENTRY) == 0 || (type & T_CODE1_IF1)) && !r.isBit(8)));
 	}
 	void opRR(const Reg& r1, const Reg& r2, uint64_t type, int code)
@@ -2767,6 +3205,7 @@ private:
 		// can't use opMR
 		rex(addr, reg, type);
 		if (type & T_0F) db(0x0F);
+		countInsn();
 		db(code);
 		opAddr(addr, reg.getIdx());
 	}
@@ -2794,6 +3233,7 @@ private:
 	void opJmp(T& label, LabelType type, uint8_t shortCode, uint8_t longCode, uint8_t longPref)
 	{
 		if (type == T_FAR) XBYAK_THROW(ERR_NOT_SUPPORTED)
+		countInsn();
 		if (isAutoGrow() && size_ + 16 >= maxSize_) growMemory(); /* avoid splitting code of jmp */
 		size_t offset = 0;
 		if (labelMgr_.getOffset(&offset, label)) { /* label exists */
@@ -2812,9 +3252,89 @@ private:
 			labelMgr_.addUndefinedLabel(label, jmp);
 		}
 	}
+#ifdef XBYAK64
+	struct VeneerSite {
+		size_t offset; // offset of rel32
+		const void *addr; // target
+		VeneerSite(size_t offset, const void *addr) : offset(offset), addr(addr) {}
+	};
+	typedef std::vector<VeneerSite> VeneerSiteList;
+	typedef XBYAK_STD_UNORDERED_MAP<const void*, size_t> VeneerStubList; // target -> offset of stub
+	static const size_t veneerStubSize = 14;
+	/*
+		put a stub `jmp qword [rip]; dq target` at the end of the code for each target out of rel32 range of the recorded sites
+		and make each site jump to the target directly if possible, otherwise to its stub (AutoGrow mode)
+	*/
+	void putVeneer()
+	{
+		if (veneerSiteList_.empty()) return;
+		VeneerStubList stubList;
+		// grow the buffer in advance so that the address of the code is fixed
+		for (VeneerSiteList::const_iterator i = veneerSiteList_.begin(), ie = veneerSiteList_.end(); i != ie; ++i) {
+			stubList.insert(VeneerStubList::value_type(i->addr, 0));
+		}
+		while (size_ + stubList.size() * veneerStubSize >= maxSize_) growMemory();
+		stubList.clear();
+		for (VeneerSiteList::const_iterator i = veneerSiteList_.begin(), ie = veneerSiteList_.end(); i != ie; ++i) {
+			if (inner::IsInInt32(size_t(i->addr) - size_t(top_ + i->offset + 4))) continue;
+			if (stubList.find(i->addr) != stubList.end()) continue;
+			stubList.insert(VeneerStubList::value_type(i->addr, size_));
+			countInsn();
+			db(0xFF); db(0x25); dd(0); // jmp qword [rip]
+			dq(size_t(i->addr));
+		}
+		for (VeneerSiteList::const_iterator i = veneerSiteList_.begin(), ie = veneerSiteList_.end(); i != ie; ++i) {
+			VeneerStubList::const_iterator stub = stubList.find(i->addr);
+			if (stub != stubList.end()) {
+				save(i->offset, stub->second - (i->offset + 4), 4, inner::LasIs);
+			} else {
+				// same as opJmpAbs
+				save(i->offset, size_t(i->addr) - (i->offset + 4), 4, inner::Labs);
+			}
+		}
+		veneerSiteList_.clear();
+	}
+	/*
+		return the address of the stub `jmp qword [rip]; dq addr` put at the end of the hot section (not AutoGrow mode)
+		the stub is shared by the sites of the same target
+	*/
+	const uint8_t *getVeneerStub(const void *addr)
+	{
+		VeneerStubList::const_iterator i = veneerStubList_.find(addr);
+		if (i != veneerStubList_.end()) return top_ + i->second;
+		const size_t offset = reserveTail(veneerStubSize);
+		if (GetError()) return 0;
+		uint8_t *p = top_ + offset;
+		const uint8_t stub[] = { 0xFF, 0x25, 0, 0, 0, 0 }; // jmp qword [rip]
+		for (size_t j = 0; j < sizeof(stub); j++) p[j] = stub[j];
+		const uint64_t v = uint64_t(size_t(addr));
+		for (size_t j = 0; j < 8; j++) p[sizeof(stub) + j] = uint8_t(v >> (j * 8));
+		countInsn();
+		veneerStubList_.insert(VeneerStubList::value_type(addr, offset));
+		return p;
+	}
+#endif
 	void opJmpAbs(const void *addr, LabelType type, uint8_t shortCode, uint8_t longCode, uint8_t longPref = 0)
 	{
 		if (type == T_FAR) XBYAK_THROW(ERR_NOT_SUPPORTED)
+		countInsn();
+#ifdef XBYAK64
+		if (useVeneer_ && type != T_SHORT) {
+			if (isAutoGrow()) {
+				// the address is fixed by putVeneer() in ready()
+				if (size_ + 16 >= maxSize_) growMemory();
+				if (longPref) db(longPref);
+				db(longCode);
+				veneerSiteList_.push_back(VeneerSite(size_, addr));
+				dd(0);
+				return;
+			}
+			if (!inner::IsInInt32(reinterpret_cast<const uint8_t*>(addr) - getCurr())) {
+				addr = getVeneerStub(addr);
+				if (addr == 0) return;
+			}
+		}
+#endif
 		if (isAutoGrow()) {
 			if (!isNEAR(type)) XBYAK_THROW(ERR_ONLY_T_NEAR_IS_SUPPORTED_IN_AUTO_GROW)
 			if (size_ + 16 >= maxSize_) growMemory();
@@ -3016,6 +3536,7 @@ private:
 		uint32_t immBit = getImmBit(op, imm);
 		if (op.isREG() && op.getIdx() == 0 && (op.getBit() == immBit || (op.isBit(64) && immBit == 32))) { // rax, eax, ax, al
 			rex(op);
+			countInsn();
 			db(code | 4 | (immBit == 8 ? 0 : 1));
 		} else {
 			int tmp = immBit < (std::min)(op.getBit(), 32U) ? 2 : 0;
@@ -3047,7 +3568,7 @@ private:
 		verifyMemHasSize(op);
 #ifndef XBYAK64
 		if (op.isREG() && !op.isBit(8)) {
-			rex(op); db((ext ? 0x48 : 0x40) | op.getIdx());
+			rex(op); countInsn(); db((ext ? 0x48 : 0x40) | op.getIdx());
 			return;
 		}
 #endif
@@ -3058,6 +3579,7 @@ private:
 		if (op.isREG() && op.hasRex2()) {
 			const Reg& r = static_cast<const Reg&>(op);
 			rex2(0, rexRXB(3, 0, Reg(), r), Reg(), r);
+			countInsn();
 			db(alt | (r.getIdx() & 7));
 			return;
 		}
@@ -3066,6 +3588,7 @@ private:
 			if (bit == 16) db(0x66);
 			if (op.isREG()) {
 				if (op.getReg().getIdx() >= 8) db(0x41);
+				countInsn();
 				db(alt | (op.getIdx() & 7));
 				return;
 			}
@@ -3082,6 +3605,7 @@ private:
 	void opPushPopP(const Reg64& r, int alt)
 	{
 		rex2(0, rexRXB(3, 1, Reg(), r), Reg(), r);
+		countInsn();
 		db(alt | (r.getIdx() & 7));
 	}
 #endif
@@ -3097,6 +3621,7 @@ private:
 		int bit = reg.getBit();
 		const int idx = reg.getIdx();
 		int code = 0xB0 | ((bit == 8 ? 0 : 1) << 3);
+		countInsn();
 		if (bit == 64 && (imm & ~uint64_t(0xffffffffu)) == 0) {
 			rex(Reg32(idx));
 			bit = 32;
@@ -3146,6 +3671,7 @@ private:
 		if (!code) XBYAK_THROW(ERR_BAD_MEM_SIZE)
 		if (m64ext && addr.isBit(64)) ext = m64ext;
 		rex(addr, st0);
+		countInsn();
 		db(code);
 		opAddr(addr, ext);
 	}
@@ -3155,11 +3681,13 @@ private:
 	{
 		uint32_t code = reg1.getIdx() == 0 ? code1 : reg2.getIdx() == 0 ? code2 : 0;
 		if (!code) XBYAK_THROW(ERR_BAD_ST_COMBINATION)
+		countInsn();
 		db(uint8_t(code >> 8));
 		db(uint8_t(code | (reg1.getIdx() | reg2.getIdx())));
 	}
 	void opFpu(const Fpu& reg, uint8_t code1, uint8_t code2)
 	{
+		countInsn();
 		db(code1); db(code2 | reg.getIdx());
 	}
 	void opVex(const Reg& r, const Operand *p1, const Operand& op2, uint64_t type, int code, int imm8 = NONE)
@@ -3396,6 +3924,7 @@ private:
 	void opInOut(const Reg& a, const Reg& d, uint8_t code)
 	{
 		if (a.getIdx() == Operand::AL && d.getIdx() == Operand::DX && d.getBit() == 16) {
+			countInsn();
 			switch (a.getBit()) {
 			case 8: db(code); return;
 			case 16: db(0x66); db(code + 1); return;
@@ -3407,6 +3936,7 @@ private:
 	void opInOut(const Reg& a, uint8_t code, uint8_t v)
 	{
 		if (a.getIdx() == Operand::AL) {
+			countInsn();
 			switch (a.getBit()) {
 			case 8: db(code); db(v); return;
 			case 16: db(0x66); db(code + 1); db(v); return;
@@ -3492,7 +4022,7 @@ private:
 	void opEncodeKey(const Reg32& r1, const Reg32& r2, uint8_t code1, uint8_t code2)
 	{
 		if (r1.getIdx() < 8 && r2.getIdx() < 8) {
-			db(0xF3); db(0x0F); db(0x38); db(code1); setModRM(3, r1.getIdx(), r2.getIdx());
+			db(0xF3); db(0x0F); db(0x38); countInsn(); db(code1); setModRM(3, r1.getIdx(), r2.getIdx());
 			return;
 		}
 		opROO(Reg(), r2, r1, T_MUST_EVEX|T_F3, code2);
@@ -3533,20 +4063,28 @@ private:
 public:
 	unsigned int getVersion() const { return VERSION; }
 	using CodeArray::db;
-#ifdef XBYAK_USE_CONSTEXPR_REGISTERS
-	#define XBYAK_DEFINE_REGISTER(Type, name, ...) static constexpr Type name{__VA_ARGS__};
-#else
+#ifndef XBYAK_USE_CONSTEXPR_REGISTERS
 	#define XBYAK_DEFINE_REGISTER(Type, name, ...) const Type name;
-#endif
 	XBYAK_FOR_EACH_REGISTER(XBYAK_DEFINE_REGISTER)
 	XBYAK_FOR_EACH_CONVENIENCE_ALL(XBYAK_DEFINE_REGISTER)
 	#undef XBYAK_DEFINE_REGISTER
+#endif
 private:
+#ifdef XBYAK64
+	VeneerSiteList veneerSiteList_; // sites in AutoGrow mode
+	VeneerStubList veneerStubList_; // stubs in the other mode
+	bool useVeneer_;
+#endif
 	bool isDefaultJmpNEAR_;
 	PreferredEncoding defaultEncoding_[2]; // 0:vnni, 1:vmpsadbw
 public:
+#ifdef XBYAK_USE_METRICS
+	void L(const std::string& label) { labelMgr_.defineSlabel(label); metrics_.labelNum++; }
+	void L(Label& label) { labelMgr_.defineClabel(label); metrics_.labelNum++; }
+#else
 	void L(const std::string& label) { labelMgr_.defineSlabel(label); }
 	void L(Label& label) { labelMgr_.defineClabel(label); }
+#endif
 	Label L() { Label label; L(label); return label; }
 	void inLocalLabel() { labelMgr_.enterLocal(); }
 	void outLocalLabel() { labelMgr_.leaveLocal(); }
@@ -3566,6 +4104,13 @@ public:
 
 	// set default type of `jmp` of undefined label to T_NEAR
 	void setDefaultJmpNEAR(bool isNear) { isDefaultJmpNEAR_ = isNear; }
+#ifdef XBYAK64
+	/*
+		route call/jmp/jcc to an address out of rel32 range through a stub `jmp qword [rip]`
+		the stub is put at the end of the hot section at once, or at the end of the code by ready() in AutoGrow mode
+	*/
+	void setVeneer(bool enable) { useVeneer_ = enable; }
+#endif
 	void jmp(const Operand& op, LabelType type = T_AUTO) { opJmpOp(op, type, 4); }
 	void jmp(std::string label, LabelType type = T_AUTO) { opJmp(label, type, 0xEB, 0xE9, 0); }
 	void jmp(const char *label, LabelType type = T_AUTO) { jmp(std::string(label), type); }
@@ -3594,6 +4139,7 @@ public:
 		int immSize = (std::min)(op.getBit() / 8, 4U);
 		if (op.isREG() && op.getIdx() == 0) { // al, ax, eax
 			rex(op);
+			countInsn();
 			db(0xA8 | (op.isBit(8) ? 0 : 1));
 		} else {
 			opRext(op, 0, 0, 0, 0xF6, false, immSize);
@@ -3614,6 +4160,7 @@ public:
 	void pop(const Operand& op) { opPushPop(op, 0x8F, 0, 0x58); }
 	void push(const AddressFrame& af, uint32_t imm)
 	{
+		countInsn();
 		if (af.bit_ == 8) {
 			db(0x6A); db(imm);
 		} else if (af.bit_ == 16) {
@@ -3650,6 +4197,7 @@ public:
 		if (addr && addr->is64bitDisp()) {
 			if (code) {
 				rex(*reg);
+				countInsn();
 				db(op1.isREG(8) ? 0xA0 : op1.isREG() ? 0xA1 : op2.isREG(8) ? 0xA2 : 0xA3);
 				if (addr->getLabel()) {
 					putL_inner(*addr->getLabel(), false, addr->getDisp() - addr->immSize, 8);
@@ -3663,6 +4211,7 @@ public:
 #else
 		if (code && addr->isOnlyDisp()) {
 			rex(*reg, *addr);
+			countInsn();
 			db(code | (reg->isBit(8) ? 0 : 1));
 			if (addr->getLabel()) {
 				putL_inner(*addr->getLabel(), false, addr->getDisp() - addr->immSize);
@@ -3719,7 +4268,7 @@ public:
 			&& (p2->getIdx() != 0 || !p1->isREG(32))
 #endif
 		) {
-			rex(*p2, *p1); db(0x90 | (p2->getIdx() & 7));
+			rex(*p2, *p1); countInsn(); db(0x90 | (p2->getIdx() & 7));
 			return;
 		}
 		if (p1->isREG() && p2->isREG()) std::swap(p1, p2); // adapt to NASM 2.16.03 behavior to pass tests
@@ -3729,6 +4278,7 @@ public:
 #ifndef XBYAK_DISABLE_SEGMENT
 	void push(const Segment& seg)
 	{
+		countInsn();
 		switch (seg.getIdx()) {
 		case Segment::es: db(0x06); break;
 		case Segment::cs: db(0x0E); break;
@@ -3742,6 +4292,7 @@ public:
 	}
 	void pop(const Segment& seg)
 	{
+		countInsn();
 		switch (seg.getIdx()) {
 		case Segment::es: db(0x07); break;
 		case Segment::cs: XBYAK_THROW(ERR_BAD_COMBINATION)
@@ -3785,6 +4336,9 @@ public:
 		XBYAK_FOR_EACH_REGISTER(XBYAK_INIT_REGISTER)
 		XBYAK_FOR_EACH_CONVENIENCE_ALL(XBYAK_INIT_REGISTER)
 		#undef XBYAK_INIT_REGISTER
+#endif
+#ifdef XBYAK64
+		, useVeneer_(false)
 #endif
 		, isDefaultJmpNEAR_(false)
 	{
@@ -3798,7 +4352,14 @@ public:
 		resetSize();
 		labelMgr_.reset();
 		labelMgr_.set(this);
+#ifdef XBYAK64
+		veneerSiteList_.clear();
+		veneerStubList_.clear();
+#endif
 		if (isAllocType() && useProtect() && curMode_ == PROTECT_RE) setProtectModeRW();
+#ifdef XBYAK_USE_METRICS
+		beginMetrics();
+#endif
 	}
 	bool hasUndefinedLabel() const { return labelMgr_.hasUndefSlabel() || labelMgr_.hasUndefClabel(); }
 	/*
@@ -3807,11 +4368,18 @@ public:
 	*/
 	void ready(ProtectMode mode = PROTECT_RWE)
 	{
+		switchToHot();
 		if (hasUndefinedLabel()) XBYAK_THROW(ERR_LABEL_IS_NOT_FOUND)
+#ifdef XBYAK64
+		putVeneer();
+#endif
 		if (isAutoGrow()) {
 			calcJmpAddress();
 			if (useProtect()) setProtectMode(mode);
 		}
+#ifdef XBYAK_USE_METRICS
+		endMetrics();
+#endif
 	}
 	// set read/exec
 	void readyRE() { return ready(PROTECT_RE); }
@@ -3851,6 +4419,7 @@ public:
 			if (rex) db(0x40 | rex);
 			db(0x0F);
 		}
+		countInsn();
 		db(0xC8 + (idx & 7));
 	}
 	void vmovd(const Operand& op1, const Operand& op2, PreferredEncoding enc = DefaultEncoding)
@@ -3881,6 +4450,7 @@ public:
 	{
 		if (useMultiByteNop == 0) {
 			for (size_t i = 0; i < size; i++) {
+				countInsn();
 				db(0x90);
 			}
 			return;
@@ -3913,6 +4483,7 @@ public:
 		while (size > 0) {
 			size_t len = (std::min)(n, size);
 			const uint8_t *seq = nopTbl[len - 1];
+			countInsn();
 			db(seq, len);
 			size -= len;
 		}
@@ -20,6 +20,8 @@
 #else
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <math.h>
 
 /**
 	utility class and functions for Xbyak
@@ -86,6 +88,25 @@
 #endif
 #ifdef __linux__
 	#define XBYAK_USE_PERF
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+#endif
+
+// KernelCache and ModuleBuilder require C++11 threads
+#if !defined(XBYAK_ONLY_CLASS_CPU) && ((__cplusplus >= 201103) || (defined(_MSC_VER) && (_MSC_VER >= 1900)))
+	#define XBYAK_UTIL_HAS_THREAD
+	#include <memory>
+	#include <list>
+	#include <mutex>
+	#include <condition_variable>
+	#include <functional>
+	#include <unordered_map>
+	#include <deque>
+	#include <thread>
+	#include <atomic>
+	#include <exception>
+	#include <chrono>
 #endif
 
 #ifndef XBYAK_CPU_CACHE
@@ -96,20 +117,23 @@
 #ifndef XBYAK_CPUMASK_COMPACT
 	#define XBYAK_CPUMASK_COMPACT 1
 #endif
-#if XBYAK_CPUMASK_COMPACT == 0
-	#include <set>
-#endif
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <sched.h>
 #endif
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
 namespace Xbyak { namespace util {
 class CpuTopology;
 class Cpu;
 namespace impl {
 
-bool initCpuTopology(CpuTopology& cpuTopo);
+bool initCpuTopology(CpuTopology& cpuTopo, const char *sysfsRoot);
 
 } // Xbyak::util::impl
 } } // Xbyak::util
@@ -810,9 +834,100 @@ public:
 	{
 		return (type & type_) == type;
 	}
+	// all detected features
+	const Type& getType() const { return type_; }
 	int getAVX10version() const { return avx10version_; }
 	int getACEVersion() const { return aceVersion_; }
 	int getMaxPalette() const { return maxPalette_; }
+	/*
+		process-wide Cpu which executes cpuid only once
+		the initialization is thread-safe on C++11 or later
+	*/
+	static const Cpu& getInstance() { return instance(); }
+	/*
+		replace the instance returned by getInstance() (e.g. by a Cpu restored by setStr() for testing)
+		call it before other threads use getInstance()
+	*/
+	static void setInstance(const Cpu& cpu) { instance() = cpu; }
+#ifndef XBYAK_ONLY_CLASS_CPU
+	/*
+		serialize all detected values into one line
+		it can be used as a key of a cache of generated code
+	*/
+	std::string getStr() const
+	{
+		const uint64_t tbl[] = {
+			type_.getL(), type_.getH(),
+			uint32_t(family), uint32_t(model), uint32_t(stepping), uint32_t(extFamily), uint32_t(extModel), uint32_t(displayFamily), uint32_t(displayModel),
+			numCores_[0], numCores_[1], avx10version_, aceVersion_, maxPalette_, dataCacheLevels_,
+		};
+		std::string s = "cpu1";
+		char buf[32];
+		for (size_t i = 0; i < sizeof(tbl) / sizeof(tbl[0]); i++) {
+			snprintf(buf, sizeof(buf), " %llx", (unsigned long long)tbl[i]);
+			s += buf;
+		}
+		for (uint32_t i = 0; i < dataCacheLevels_; i++) {
+			snprintf(buf, sizeof(buf), " %x %x", dataCacheSize_[i], coresSharingDataCache_[i]);
+			s += buf;
+		}
+		return s;
+	}
+	/*
+		restore the values serialized by getStr()
+		return false (and do not change this) if str is invalid
+	*/
+	bool setStr(const char *str)
+	{
+		const char header[] = "cpu1";
+		if (strncmp(str, header, sizeof(header) - 1) != 0) return false;
+		const char *p = str + sizeof(header) - 1;
+		const size_t fixedN = 15;
+		uint64_t tbl[fixedN + maxNumberCacheLevels * 2];
+		size_t n = fixedN;
+		for (size_t i = 0; i < n; i++) {
+			char *endp;
+			if (*p != ' ') return false;
+			tbl[i] = strtoull(p + 1, &endp, 16);
+			if (endp == p + 1) return false;
+			p = endp;
+			if (i == fixedN - 1) {
+				if (tbl[i] > maxNumberCacheLevels) return false;
+				n += size_t(tbl[i]) * 2;
+			}
+		}
+		if (*p != '\0') return false;
+		Cpu cpu(*this);
+		cpu.type_ = Type(tbl[0], tbl[1]);
+		cpu.family = int(tbl[2]);
+		cpu.model = int(tbl[3]);
+		cpu.stepping = int(tbl[4]);
+		cpu.extFamily = int(tbl[5]);
+		cpu.extModel = int(tbl[6]);
+		cpu.displayFamily = int(tbl[7]);
+		cpu.displayModel = int(tbl[8]);
+		cpu.numCores_[0] = uint32_t(tbl[9]);
+		cpu.numCores_[1] = uint32_t(tbl[10]);
+		cpu.avx10version_ = uint32_t(tbl[11]);
+		cpu.aceVersion_ = uint32_t(tbl[12]);
+		cpu.maxPalette_ = uint32_t(tbl[13]);
+		cpu.dataCacheLevels_ = uint32_t(tbl[14]);
+		for (uint32_t i = 0; i < maxNumberCacheLevels; i++) {
+			const bool valid = i < cpu.dataCacheLevels_;
+			cpu.dataCacheSize_[i] = valid ? uint32_t(tbl[fixedN + i * 2]) : 0;
+			cpu.coresSharingDataCache_[i] = valid ? uint32_t(tbl[fixedN + i * 2 + 1]) : 0;
+		}
+		*this = cpu;
+		return true;
+	}
+	bool setStr(const std::string& str) { return setStr(str.c_str()); }
+#endif
+private:
+	static Cpu& instance()
+	{
+		static Cpu cpu;
+		return cpu;
+	}
 };
 #ifdef _MSC_VER
 	#pragma warning(pop)
@@ -860,6 +975,59 @@ inline const char* getCacheTypeStr(int type)
 
 namespace impl {
 
+inline uint32_t popcnt(uint64_t mask)
+{
+#if defined(_M_X64) || defined(_M_AMD64)
+	return (int)__popcnt64(mask);
+#elif defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(mask);
+#else
+	uint32_t count = 0;
+	while (mask) {
+		count += (mask & 1);
+		mask >>= 1;
+	}
+	return count;
+#endif
+}
+
+// the index of the lowest set bit (mask != 0)
+inline uint32_t bsf64(uint64_t mask)
+{
+	assert(mask);
+#if defined(_M_X64) || defined(_M_AMD64)
+	unsigned long idx;
+	_BitScanForward64(&idx, mask);
+	return uint32_t(idx);
+#elif defined(__GNUC__) || defined(__clang__)
+	return uint32_t(__builtin_ctzll(mask));
+#else
+	uint32_t idx = 0;
+	while ((mask & 1) == 0) {
+		mask >>= 1;
+		idx++;
+	}
+	return idx;
+#endif
+}
+
+// the index of the highest set bit (mask != 0)
+inline uint32_t bsr64(uint64_t mask)
+{
+	assert(mask);
+#if defined(_M_X64) || defined(_M_AMD64)
+	unsigned long idx;
+	_BitScanReverse64(&idx, mask);
+	return uint32_t(idx);
+#elif defined(__GNUC__) || defined(__clang__)
+	return uint32_t(63 - __builtin_clzll(mask));
+#else
+	uint32_t idx = 0;
+	while (mask >>= 1) idx++;
+	return idx;
+#endif
+}
+
 inline void appendStr(std::string& s, uint32_t v)
 {
 #if __cplusplus >= 201103L
@@ -906,7 +1074,11 @@ bool setStr(T& x, const char *str)
 #define XBYAK_CPUMASK_N 6
 #endif
 #ifndef XBYAK_CPUMASK_BITN
-#define XBYAK_CPUMASK_BITN 10 // max number of logical cpu = 1024
+	#if XBYAK_CPUMASK_COMPACT == 1
+		#define XBYAK_CPUMASK_BITN 10 // max number of logical cpu = 1024
+	#else
+		#define XBYAK_CPUMASK_BITN 16 // max number of logical cpu = 65536
+	#endif
 #endif
 #if XBYAK_CPUMASK_COMPACT == 1
 /*
@@ -959,6 +1131,33 @@ class CpuMask {
 		return false;
 	}
 #endif
+	// keep the indices only in this, in both, and only in rhs respectively
+	CpuMask combine(const CpuMask& rhs, bool keepL, bool keepBoth, bool keepR) const
+	{
+		CpuMask m;
+		const_iterator i = begin(), ie = end();
+		const_iterator j = rhs.begin(), je = rhs.end();
+		while (i != ie || j != je) {
+			uint32_t v;
+			bool keep;
+			if (j == je || (i != ie && *i < *j)) {
+				v = *i;
+				++i;
+				keep = keepL;
+			} else if (i == ie || *j < *i) {
+				v = *j;
+				++j;
+				keep = keepR;
+			} else {
+				v = *i;
+				++i;
+				++j;
+				keep = keepBoth;
+			}
+			if (keep && !m.append(v)) break;
+		}
+		return m;
+	}
 public:
 	CpuMask() { clear(); }
 	class ConstIterator {
@@ -1108,6 +1307,21 @@ public:
 		}
 		return false;
 	}
+	bool contains(uint32_t idx) const
+	{
+		for (const_iterator it = begin(), e = end(); it != e && *it <= idx; ++it) {
+			if (*it == idx) return true;
+		}
+		return false;
+	}
+	bool intersects(const CpuMask& rhs) const { return !(*this & rhs).empty(); }
+	CpuMask operator&(const CpuMask& rhs) const { return combine(rhs, false, true, false); }
+	CpuMask operator|(const CpuMask& rhs) const { return combine(rhs, true, true, true); }
+	// remove the indices in rhs
+	CpuMask operator-(const CpuMask& rhs) const { return combine(rhs, true, false, false); }
+	CpuMask& operator&=(const CpuMask& rhs) { return *this = *this & rhs; }
+	CpuMask& operator|=(const CpuMask& rhs) { return *this = *this | rhs; }
+	CpuMask& operator-=(const CpuMask& rhs) { return *this = *this - rhs; }
 	void dump() const
 	{
 		printf("a_:");
@@ -1125,39 +1339,166 @@ public:
 	}
 };
 #else
+/*
+	bitset of logical cpu indices
+	words_[i] has the indices in [i * 64, i * 64 + 63]
+	words_.back() != 0 unless words_ is empty
+	Max number of cpu = 2**bitN
+*/
 class CpuMask {
-	typedef std::set<uint32_t> IntSet;
-	IntSet indices_;
+	static const uint32_t maxN = uint32_t(1) << XBYAK_CPUMASK_BITN;
+	std::vector<uint64_t> words_;
+	void trim()
+	{
+		while (!words_.empty() && words_.back() == 0) words_.pop_back();
+	}
+	// the largest index (words_ must not be empty)
+	uint32_t last() const
+	{
+		return uint32_t((words_.size() - 1) * 64 + impl::bsr64(words_.back()));
+	}
+	void setBit(uint32_t v)
+	{
+		const size_t q = v / 64;
+		if (q >= words_.size()) words_.resize(q + 1);
+		words_[q] |= uint64_t(1) << (v % 64);
+	}
 public:
-	CpuMask() : indices_() {}
-	typedef IntSet::const_iterator const_iterator;
+	CpuMask() : words_() {}
+	class ConstIterator {
+		const uint64_t *p_;
+		size_t n_;
+		size_t q_; // current word
+		uint64_t w_; // the remaining bits of p_[q_]
+		friend class CpuMask;
+		void skip()
+		{
+			while (w_ == 0 && ++q_ < n_) w_ = p_[q_];
+		}
+	public:
+		ConstIterator(const CpuMask& parent)
+			: p_(parent.words_.empty() ? 0 : &parent.words_[0]), n_(parent.words_.size()), q_(0), w_(n_ ? p_[0] : 0)
+		{
+			if (n_) skip();
+		}
+		uint32_t operator*() const { return uint32_t(q_ * 64 + impl::bsf64(w_)); }
+		ConstIterator& operator++()
+		{
+			w_ &= w_ - 1;
+			skip();
+			return *this;
+		}
+		bool operator==(const ConstIterator& rhs) const { return q_ == rhs.q_ && w_ == rhs.w_; }
+		bool operator!=(const ConstIterator& rhs) const { return !operator==(rhs); }
+	};
+	typedef ConstIterator const_iterator;
 	typedef const_iterator iterator;
-	const_iterator begin() const { return indices_.begin(); }
-	const_iterator end() const { return indices_.end(); }
+	const_iterator begin() const { return ConstIterator(*this); }
+	const_iterator end() const
+	{
+		ConstIterator it(*this);
+		it.q_ = it.n_;
+		it.w_ = 0;
+		return it;
+	}
 
-	void clear() { indices_.clear(); }
-	bool empty() const { return indices_.empty(); }
-	bool operator<(const CpuMask& rhs) const { return indices_ < rhs.indices_; }
-	bool operator>(const CpuMask& rhs) const { return indices_ > rhs.indices_; }
+	void clear() { words_.clear(); }
+	bool empty() const { return words_.empty(); }
+	// lexicographical order of the indices as std::set<uint32_t>
+	bool operator<(const CpuMask& rhs) const
+	{
+		const size_t n = (std::min)(words_.size(), rhs.words_.size());
+		for (size_t i = 0; i < n; i++) {
+			const uint64_t x = words_[i], y = rhs.words_[i];
+			if (x == y) continue;
+			const uint32_t b = impl::bsf64(x ^ y);
+			// the mask which has b is less if the other has an index larger than b
+			const CpuMask& hasB = (x >> b) & 1 ? *this : rhs;
+			const CpuMask& other = (x >> b) & 1 ? rhs : *this;
+			const bool otherHasLarger = other.last() > i * 64 + b;
+			return (&hasB == this) == otherHasLarger;
+		}
+		return words_.size() < rhs.words_.size();
+	}
+	bool operator>(const CpuMask& rhs) const { return rhs < *this; }
 	bool operator>=(const CpuMask& rhs) const { return !operator<(rhs); }
 	bool operator<=(const CpuMask& rhs) const { return !operator>(rhs); }
-	bool operator==(const CpuMask& rhs) const { return indices_ == rhs.indices_; }
+	bool operator==(const CpuMask& rhs) const { return words_ == rhs.words_; }
 	bool operator!=(const CpuMask& rhs) const { return !operator==(rhs); }
 	// idx should be monotonically increasing
 	bool append(uint32_t idx)
 	{
-		if (idx >= (1u << XBYAK_CPUMASK_BITN)) return false;
-		if (!indices_.empty() && *indices_.rbegin() >= idx) return false;
-		indices_.insert(idx);
+		if (idx >= maxN) return false;
+		if (!empty() && last() >= idx) return false;
+		setBit(idx);
 		return true;
 	}
 	// add range [a, b] which means a, a+1, ..., b
 	bool appendRange(uint32_t a, uint32_t b)
 	{
-		if (a > b) return false;
-		while (a <= b) {
-			if (!append(a)) return false;
-			a++;
+		if (a > b || b >= maxN) return false;
+		if (!empty() && last() >= a) return false;
+		const size_t qa = a / 64, qb = b / 64;
+		words_.resize(qb + 1);
+		const uint64_t full = ~uint64_t(0);
+		const uint64_t lo = full << (a % 64);
+		const uint64_t hi = full >> (63 - b % 64);
+		if (qa == qb) {
+			words_[qa] |= lo & hi;
+			return true;
+		}
+		words_[qa] |= lo;
+		for (size_t i = qa + 1; i < qb; i++) words_[i] = full;
+		words_[qb] = hi;
+		return true;
+	}
+	bool contains(uint32_t idx) const
+	{
+		const size_t q = idx / 64;
+		return q < words_.size() && ((words_[q] >> (idx % 64)) & 1);
+	}
+	bool intersects(const CpuMask& rhs) const
+	{
+		const size_t n = (std::min)(words_.size(), rhs.words_.size());
+		for (size_t i = 0; i < n; i++) {
+			if (words_[i] & rhs.words_[i]) return true;
+		}
+		return false;
+	}
+	CpuMask& operator&=(const CpuMask& rhs)
+	{
+		if (words_.size() > rhs.words_.size()) words_.resize(rhs.words_.size());
+		for (size_t i = 0; i < words_.size(); i++) words_[i] &= rhs.words_[i];
+		trim();
+		return *this;
+	}
+	CpuMask& operator|=(const CpuMask& rhs)
+	{
+		if (words_.size() < rhs.words_.size()) words_.resize(rhs.words_.size());
+		for (size_t i = 0; i < rhs.words_.size(); i++) words_[i] |= rhs.words_[i];
+		return *this;
+	}
+	// remove the indices in rhs
+	CpuMask& operator-=(const CpuMask& rhs)
+	{
+		const size_t n = (std::min)(words_.size(), rhs.words_.size());
+		for (size_t i = 0; i < n; i++) words_[i] &= ~rhs.words_[i];
+		trim();
+		return *this;
+	}
+	CpuMask operator&(const CpuMask& rhs) const { CpuMask m(*this); m &= rhs; return m; }
+	CpuMask operator|(const CpuMask& rhs) const { CpuMask m(*this); m |= rhs; return m; }
+	CpuMask operator-(const CpuMask& rhs) const { CpuMask m(*this); m -= rhs; return m; }
+	// raw bits (bit i of getWords()[q] is the index q * 64 + i)
+	const uint64_t *getWords() const { return words_.empty() ? 0 : &words_[0]; }
+	size_t getWordNum() const { return words_.size(); }
+	bool setWords(const uint64_t *words, size_t n)
+	{
+		words_.assign(words, words + n);
+		trim();
+		if (!empty() && last() >= maxN) {
+			clear();
+			return false;
 		}
 		return true;
 	}
@@ -1169,41 +1510,45 @@ public:
 	std::string getStr() const
 	{
 		std::string s;
-		bool inRange = false;
-		uint32_t prev = 0x80000000;
-		for (const_iterator i = indices_.begin(); i != indices_.end(); ++i) {
-			uint32_t v = *i;
-			if (inRange) {
-				if (prev + 1 != v) {
-					impl::appendStr(s, prev);
-					inRange = false;
-					s += ',';
-					impl::appendStr(s, v);
-				}
-			} else {
-				if (prev + 1 == v) {
-					// start range
-					s += '-';
-					inRange = true;
-				} else {
-					if (!s.empty()) s += ',';
-					impl::appendStr(s, v);
-				}
+		const_iterator i = begin();
+		const const_iterator e = end();
+		while (i != e) {
+			const uint32_t a = *i;
+			uint32_t b = a;
+			while (++i != e && *i == b + 1) b++;
+			if (!s.empty()) s += ',';
+			impl::appendStr(s, a);
+			if (b != a) {
+				s += '-';
+				impl::appendStr(s, b);
 			}
-			prev = v;
-		}
-		if (inRange) {
-			impl::appendStr(s, prev);
 		}
 		return s;
 	}
-	size_t size() const { return indices_.size(); }
+	size_t size() const
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < words_.size(); i++) n += impl::popcnt(words_[i]);
+		return n;
+	}
+	// the idx-th smallest index
 	uint32_t get(uint32_t idx) const
 	{
 		assert(idx < size());
-		const_iterator it = indices_.begin();
-		std::advance(it, idx);
-		return *it;
+		for (size_t i = 0; i < words_.size(); i++) {
+			uint64_t w = words_[i];
+			const uint32_t n = impl::popcnt(w);
+			if (idx >= n) {
+				idx -= n;
+				continue;
+			}
+			while (idx > 0) {
+				w &= w - 1;
+				idx--;
+			}
+			return uint32_t(i * 64 + impl::bsf64(w));
+		}
+		return 0;
 	}
 	void put(const char *label = NULL) const
 	{
@@ -1244,35 +1589,66 @@ struct LogicalCpu {
 	LogicalCpu()
 		: coreId(0)
 		, coreType(Unknown)
+		, nodeIdx(0)
 		, cache()
 	{
 	}
 	uint32_t coreId; // index of physical core
 	CoreType coreType; // for hybrid systems
+	uint32_t nodeIdx; // index of NUMA node (CpuTopology::getNode())
 	CpuCache cache[CACHE_TYPE_NUM];
 	const CpuMask& getSiblings() const { return cache[L1i].sharedCpuIndices; }
 
 	void put(const char *label = NULL) const
 	{
 		if (label) printf("%s: ", label);
-		printf("coreId %u, type %s\n", coreId, getCoreTypeStr(coreType));
+		printf("coreId %u, type %s, node %u\n", coreId, getCoreTypeStr(coreType), nodeIdx);
 		for (int i = 0; i < CACHE_TYPE_NUM; i++) {
 			cache[i].put(getCacheTypeStr(i));
 		}
 	}
 };
 
+struct NumaNode {
+	NumaNode()
+		: id(0)
+		, memSize(0)
+		, cpus()
+		, distance()
+	{
+	}
+	uint32_t id; // node id of OS (N of /sys/devices/system/node/nodeN)
+	uint64_t memSize; // total memory of the node in bytes (0 if unknown)
+	CpuMask cpus; // logical CPUs local to the node
+	std::vector<uint32_t> distance; // distance[i] ; distance to the i-th node (10 means local)
+
+	void put(const char *label = NULL) const
+	{
+		if (label) printf("%s: ", label);
+		printf("node %u, mem %llu MiB, distance", id, (unsigned long long)(memSize >> 20));
+		for (size_t i = 0; i < distance.size(); i++) printf(" %u", distance[i]);
+		printf(", cpus ");
+		cpus.put();
+	}
+};
+
 class CpuTopology {
 public:
-	explicit CpuTopology(const Cpu& cpu)
+	/*
+		sysfsRoot ; root of sysfs to read the topology (Linux only)
+		set a directory which has the same layout as /sys for testing
+	*/
+	explicit CpuTopology(const Cpu& cpu, const char *sysfsRoot = "/sys")
 		: logicalCpus_()
+		, nodes_()
 		, physicalCoreNum_(0)
 		, lineSize_(0)
 		, isHybrid_(cpu.has(cpu.tHYBRID))
 	{
-		if (!impl::initCpuTopology(*this)) {
+		if (!impl::initCpuTopology(*this, sysfsRoot)) {
 			XBYAK_THROW(ERR_CANT_INIT_CPUTOPOLOGY);
 		}
+		if (nodes_.empty()) setSingleNode();
 	}
 
 	// Number of logical CPUs
@@ -1298,32 +1674,63 @@ public:
 
 	// Whether this is a hybrid system
 	bool isHybrid() const { return isHybrid_; }
+
+	// Number of NUMA nodes (1 if the system does not provide them)
+	size_t getNodeNum() const { return nodes_.size(); }
+
+	// Get NUMA node information
+	const NumaNode& getNode(size_t nodeIdx) const
+	{
+		return nodes_[nodeIdx];
+	}
+
+	// Distance between two nodes (10 means local)
+	uint32_t getDistance(size_t nodeIdx1, size_t nodeIdx2) const
+	{
+		return nodes_[nodeIdx1].distance[nodeIdx2];
+	}
+
+	// Logical CPUs local to the node
+	const CpuMask& getLocalCpus(size_t nodeIdx) const
+	{
+		return nodes_[nodeIdx].cpus;
+	}
+
+	// Indices of the nodes which have the logical CPUs in cpus (in ascending order)
+	std::vector<uint32_t> getNodeIndices(const CpuMask& cpus) const
+	{
+		std::vector<bool> found(nodes_.size());
+		for (CpuMask::const_iterator it = cpus.begin(); it != cpus.end(); ++it) {
+			if (*it < logicalCpus_.size()) found[logicalCpus_[*it].nodeIdx] = true;
+		}
+		std::vector<uint32_t> ret;
+		for (uint32_t i = 0; i < found.size(); i++) {
+			if (found[i]) ret.push_back(i);
+		}
+		return ret;
+	}
 private:
-	friend bool impl::initCpuTopology(CpuTopology&);
+	friend bool impl::initCpuTopology(CpuTopology&, const char *);
 	std::vector<LogicalCpu> logicalCpus_;
+	std::vector<NumaNode> nodes_;
 	size_t physicalCoreNum_;
 	uint32_t lineSize_;
 	bool isHybrid_;
+	// all CPUs belong to node 0
+	void setSingleNode()
+	{
+		nodes_.resize(1);
+		NumaNode& node = nodes_[0];
+		node.distance.assign(1, 10);
+		node.cpus.appendRange(0, uint32_t(logicalCpus_.size() - 1));
+		for (size_t i = 0; i < logicalCpus_.size(); i++) {
+			logicalCpus_[i].nodeIdx = 0;
+		}
+	}
 };
 
 namespace impl {
 
-inline uint32_t popcnt(uint64_t mask)
-{
-#if defined(_M_X64) || defined(_M_AMD64)
-	return (int)__popcnt64(mask);
-#elif defined(__GNUC__) || defined(__clang__)
-	return __builtin_popcountll(mask);
-#else
-	uint32_t count = 0;
-	while (mask) {
-		count += (mask & 1);
-		mask >>= 1;
-	}
-	return count;
-#endif
-}
-
 // fall back to CPUID leaf 0x1A
 inline CoreType getCoreType()
 {
@@ -1472,8 +1879,9 @@ inline bool convertMask(CpuMask& mask, const U32Vec& groupAcc, const CACHE_RELAT
 	return true;
 }
 
-inline bool initCpuTopology(CpuTopology& cpuTopo)
+inline bool initCpuTopology(CpuTopology& cpuTopo, const char *sysfsRoot)
 {
+	(void)sysfsRoot;
 	U32Vec groupAcc;
 	const uint32_t logicalCpuNum = getGroupAcc(groupAcc);
 	if (logicalCpuNum == 0) return false;
@@ -1524,9 +1932,10 @@ inline bool initCpuTopology(CpuTopology& cpuTopo)
 	return true;
 }
 #else
-inline bool initCpuTopology(CpuTopology& cpuTopo)
+inline bool initCpuTopology(CpuTopology& cpuTopo, const char *sysfsRoot)
 {
 	(void)cpuTopo;
+	(void)sysfsRoot;
 	return false;
 }
 #endif
@@ -1536,30 +1945,39 @@ inline bool initCpuTopology(CpuTopology& cpuTopo)
 #undef XBYAK_WINSDK_HAS_CACHE_RELATIONSHIP_GROUPMASKS
 #elif defined(__linux__) // Linux
 
-struct WrapFILE {
-	FILE *f;
-	explicit WrapFILE(const char *name)
-		: f(fopen(name, "r"))
-	{
-	}
-	~WrapFILE() { if (f) fclose(f); }
-};
+/*
+	read path into buf (up to size - 1 bytes) with '\0'
+	use open/read instead of fopen to avoid allocating a buffer per file
+*/
+inline bool readFile(char *buf, size_t size, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return false;
+	ssize_t n = read(fd, buf, size - 1);
+	close(fd);
+	if (n <= 0) return false;
+	buf[n] = '\0';
+	return true;
+}
+
+// read the first line of path into buf (without '\n')
+inline bool readLineFromFile(char *buf, size_t size, const char *path)
+{
+	if (!readFile(buf, size, path)) return false;
+	char *p = strchr(buf, '\n');
+	if (p) *p = '\0';
+	return true;
+}
 
 inline uint32_t readIntFromFile(const char* path) {
-	WrapFILE wf(path);
-	if (!wf.f) return 0;
-	uint32_t val = 0;
-	int n = fscanf(wf.f, "%u", &val);
-	return (n == 1) ? val : 0;
+	char buf[32];
+	if (!readLineFromFile(buf, sizeof(buf), path)) return 0;
+	return uint32_t(strtoul(buf, 0, 10));
 }
 
 inline bool parseCpuList(CpuMask& mask, const char* path) {
-	WrapFILE wf(path);
-	if (!wf.f) return false;
 	char buf[1024];
-	if (!fgets(buf, sizeof(buf), wf.f)) return false;
-	size_t n = strlen(buf);
-	if (n > 0 && buf[n - 1] == '\n') buf[n - 1] = '\0';
+	if (!readLineFromFile(buf, sizeof(buf), path)) return false;
 	return setStr(mask, buf);
 }
 
@@ -1572,9 +1990,117 @@ inline CoreType setAffinityAndGetCoreType(uint32_t cpu)
 	return impl::getCoreType();
 }
 
-inline bool initCpuTopology(CpuTopology& cpuTopo)
+// read the attributes of the cache in cacheDir and return its type
+inline CacheType readCpuCache(CpuCache& cache, const char *cacheDir)
+{
+	char path[1024];
+	char buf[32];
+	CacheType cacheType = CACHE_UNKNOWN;
+	snprintf(path, sizeof(path), "%s/type", cacheDir);
+	if (!readLineFromFile(buf, sizeof(buf), path)) return CACHE_UNKNOWN;
+	snprintf(path, sizeof(path), "%s/level", cacheDir);
+	const uint32_t level = readIntFromFile(path);
+	if (strcmp(buf, "Instruction") == 0) {
+		cacheType = L1i;
+	} else if (strcmp(buf, "Data") == 0 || strcmp(buf, "Unified") == 0) {
+		switch (level) {
+		case 1: if (buf[0] == 'D') cacheType = L1d; break;
+		case 2: cacheType = L2; break;
+		case 3: cacheType = L3; break;
+		default: break;
+		}
+	}
+	if (cacheType == CACHE_UNKNOWN) return CACHE_UNKNOWN;
+
+	// Read cache size
+	snprintf(path, sizeof(path), "%s/size", cacheDir);
+	if (readLineFromFile(buf, sizeof(buf), path)) {
+		char *endp;
+		uint32_t size = (uint32_t)strtoul(buf, &endp, 10);
+		switch (*endp) {
+		case '\0': cache.size = size; break;
+		case 'K': case 'k': cache.size = size * 1024; break;
+		case 'M': case 'm': cache.size = size * 1024 * 1024; break;
+		default: break;
+		}
+	}
+
+	// Read ways of associativity
+	snprintf(path, sizeof(path), "%s/ways_of_associativity", cacheDir);
+	cache.associativity = readIntFromFile(path);
+
+	// Read shared CPU list
+	snprintf(path, sizeof(path), "%s/shared_cpu_list", cacheDir);
+	parseCpuList(cache.sharedCpuIndices, path);
+	return cacheType;
+}
+
+/*
+	read NUMA nodes from sysfsRoot/devices/system/node
+	nodes is empty if they are not available
+*/
+inline void initNumaNode(std::vector<NumaNode>& nodes, std::vector<LogicalCpu>& logicalCpus, const char *sysfsRoot)
+{
+	char path[1024];
+	std::vector<char> buf(8192);
+	CpuMask online;
+	snprintf(path, sizeof(path), "%s/devices/system/node/online", sysfsRoot);
+	if (!parseCpuList(online, path)) return;
+	const size_t nodeNum = online.size();
+	if (nodeNum == 0) return;
+	nodes.resize(nodeNum);
+	size_t nodeIdx = 0;
+	for (CpuMask::const_iterator it = online.begin(); it != online.end(); ++it, nodeIdx++) {
+		NumaNode& node = nodes[nodeIdx];
+		node.id = *it;
+		snprintf(path, sizeof(path), "%s/devices/system/node/node%u/cpulist", sysfsRoot, node.id);
+		parseCpuList(node.cpus, path);
+		for (CpuMask::const_iterator c = node.cpus.begin(); c != node.cpus.end(); ++c) {
+			if (*c < logicalCpus.size()) logicalCpus[*c].nodeIdx = uint32_t(nodeIdx);
+		}
+		// "10 21" ; distances to the online nodes
+		snprintf(path, sizeof(path), "%s/devices/system/node/node%u/distance", sysfsRoot, node.id);
+		if (readLineFromFile(&buf[0], buf.size(), path)) {
+			const char *p = &buf[0];
+			for (;;) {
+				char *endp;
+				uint32_t d = uint32_t(strtoul(p, &endp, 10));
+				if (endp == p) break;
+				node.distance.push_back(d);
+				p = endp;
+			}
+		}
+		// the distance is unknown
+		if (node.distance.size() != nodeNum) {
+			node.distance.assign(nodeNum, 20);
+			node.distance[nodeIdx] = 10;
+		}
+		// "Node 0 MemTotal:       65536000 kB"
+		snprintf(path, sizeof(path), "%s/devices/system/node/node%u/meminfo", sysfsRoot, node.id);
+		if (readFile(&buf[0], buf.size(), path)) {
+			const char *p = strstr(&buf[0], "MemTotal:");
+			if (p) node.memSize = uint64_t(strtoull(p + 9, 0, 10)) * 1024;
+		}
+	}
+}
+
+/*
+	sysfsRoot is the root of sysfs ("/sys" by default)
+	the attributes of a cache shared by some cpus are read only once
+*/
+inline bool initCpuTopology(CpuTopology& cpuTopo, const char *sysfsRoot)
 {
-	const uint32_t logicalCpuNum = sysconf(_SC_NPROCESSORS_ONLN);
+	char path[1024];
+	uint32_t logicalCpuNum = 0;
+	{
+		CpuMask online;
+		snprintf(path, sizeof(path), "%s/devices/system/cpu/online", sysfsRoot);
+		if (parseCpuList(online, path)) {
+			logicalCpuNum = uint32_t(online.size());
+		} else if (strcmp(sysfsRoot, "/sys") == 0) {
+			logicalCpuNum = sysconf(_SC_NPROCESSORS_ONLN);
+		}
+	}
 
 	if (logicalCpuNum == 0) return false;
 	if (logicalCpuNum >= (1u << XBYAK_CPUMASK_BITN)) return false;
@@ -1582,92 +2108,50 @@ inline bool initCpuTopology(CpuTopology& cpuTopo)
 	cpuTopo.logicalCpus_.resize(logicalCpuNum);
 	uint32_t maxPhisicalIdx = 0;
 
+	const uint32_t notRead = 0xffffffff;
+	// ownerTbl[cacheIdx * logicalCpuNum + cpuIdx] ; cpu whose cacheIdx-th cache is the same as cpuIdx
+	std::vector<uint32_t> ownerTbl(CACHE_TYPE_NUM * logicalCpuNum, notRead);
+	// typeTbl[cacheIdx * logicalCpuNum + cpuIdx] ; type of cacheIdx-th cache of cpuIdx
+	std::vector<uint8_t> typeTbl(CACHE_TYPE_NUM * logicalCpuNum, uint8_t(CACHE_UNKNOWN));
+
 	for (uint32_t cpuIdx = 0; cpuIdx < logicalCpuNum; cpuIdx++) {
-		char path[256];
 		LogicalCpu& logCpu = cpuTopo.logicalCpus_[cpuIdx];
 
-		snprintf(path, sizeof(path),
-			"/sys/devices/system/cpu/cpu%u/topology/core_id", cpuIdx);
+		snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%u/topology/core_id", sysfsRoot, cpuIdx);
 		logCpu.coreId = readIntFromFile(path);
 		maxPhisicalIdx = (std::max)(maxPhisicalIdx, logCpu.coreId);
 
 		logCpu.coreType = Standard;
 
 		for (uint32_t cacheIdx = 0; cacheIdx < CACHE_TYPE_NUM; cacheIdx++) {
-			CacheType cacheType = CACHE_UNKNOWN;
-
-			// Map cache index to cache type
-			{
-				snprintf(path, sizeof(path),
-					"/sys/devices/system/cpu/cpu%u/cache/index%u/type", cpuIdx, cacheIdx);
-				char typeStr[32];
-				WrapFILE wf(path);
-
-				if (wf.f && fgets(typeStr, sizeof(typeStr), wf.f)) {
-					if (strncmp(typeStr, "Instruction", 11) == 0) {
-						cacheType = L1i;
-					} else if (strncmp(typeStr, "Data", 4) == 0) {
-						// Determine level
-						char path[256];
-						snprintf(path, sizeof(path),
-							"/sys/devices/system/cpu/cpu%u/cache/index%u/level", cpuIdx, cacheIdx);
-						switch (readIntFromFile(path)) {
-						case 1: cacheType = L1d; break;
-						case 2: cacheType = L2; break;
-						case 3: cacheType = L3; break;
-						default: break;;
-						}
-					} else if (strncmp(typeStr, "Unified", 7) == 0) {
-						snprintf(path, sizeof(path),
-							"/sys/devices/system/cpu/cpu%u/cache/index%u/level", cpuIdx, cacheIdx);
-						switch (readIntFromFile(path)) {
-						case 2: cacheType = L2; break;
-						case 3: cacheType = L3; break;
-						default: break;;
-						}
-					}
-				}
+			const size_t pos = cacheIdx * logicalCpuNum + cpuIdx;
+			const uint32_t owner = ownerTbl[pos];
+			if (owner != notRead) {
+				const CacheType cacheType = CacheType(typeTbl[cacheIdx * logicalCpuNum + owner]);
+				if (cacheType != CACHE_UNKNOWN) logCpu.cache[cacheType] = cpuTopo.logicalCpus_[owner].cache[cacheType];
+				continue;
 			}
+			snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%u/cache/index%u", sysfsRoot, cpuIdx, cacheIdx);
+			CpuCache cache;
+			const CacheType cacheType = readCpuCache(cache, path);
+			typeTbl[pos] = uint8_t(cacheType);
 			if (cacheType == CACHE_UNKNOWN) continue;
-			CpuCache& cache = logCpu.cache[cacheType];
-
-			// Read cache size
-			{
-				snprintf(path, sizeof(path),
-					"/sys/devices/system/cpu/cpu%u/cache/index%u/size", cpuIdx, cacheIdx);
-				char sizeStr[32];
-				WrapFILE wf(path);
-				if (wf.f && fgets(sizeStr, sizeof(sizeStr), wf.f)) {
-					char *endp;
-					uint32_t size = (uint32_t)strtoul(sizeStr, &endp, 10);
-					switch (*endp) {
-					case '\0': case '\n': cache.size = size; break;
-					case 'K': case 'k':   cache.size = size * 1024; break;
-					case 'M': case 'm':   cache.size = size * 1024 * 1024; break;
-					default: break;
-					}
-				}
+			logCpu.cache[cacheType] = cache;
+			// the other cpus sharing this cache reuse it
+			for (CpuMask::const_iterator it = cache.sharedCpuIndices.begin(); it != cache.sharedCpuIndices.end(); ++it) {
+				const uint32_t idx = *it;
+				if (idx > cpuIdx && idx < logicalCpuNum) ownerTbl[cacheIdx * logicalCpuNum + idx] = cpuIdx;
 			}
-
-			// Read ways of associativity
-			snprintf(path, sizeof(path),
-				"/sys/devices/system/cpu/cpu%u/cache/index%u/ways_of_associativity", cpuIdx, cacheIdx);
-			cache.associativity = readIntFromFile(path);
-
-			// Read shared CPU list
-			snprintf(path, sizeof(path),
-				"/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list", cpuIdx, cacheIdx);
-			parseCpuList(cache.sharedCpuIndices, path);
-
 		}
 	}
 
 	// Assign core types for hybrid architectures
 	const bool isHybrid = cpuTopo.isHybrid();
 	if (isHybrid) {
-		// For hybrid systems, try toread P-core and E-core lists from sysfs first
+		// For hybrid systems, try to read P-core and E-core lists from sysfs first
 		CpuMask pCoreMask;
-		const bool hasPCoreSysfs = parseCpuList(pCoreMask, "/sys/devices/cpu_core/cpus");
+		snprintf(path, sizeof(path), "%s/devices/cpu_core/cpus", sysfsRoot);
+		const bool hasPCoreSysfs = parseCpuList(pCoreMask, path);
 		if (hasPCoreSysfs) {
 			// Set Performance core types
 			for (CpuMask::const_iterator it = pCoreMask.begin(); it != pCoreMask.end(); ++it) {
@@ -1678,7 +2162,8 @@ inline bool initCpuTopology(CpuTopology& cpuTopo)
 			}
 		}
 		CpuMask eCoreMask;
-		const bool hasECoreSysfs = parseCpuList(eCoreMask, "/sys/devices/cpu_atom/cpus");
+		snprintf(path, sizeof(path), "%s/devices/cpu_atom/cpus", sysfsRoot);
+		const bool hasECoreSysfs = parseCpuList(eCoreMask, path);
 		if (hasECoreSysfs) {
 			// Set Efficient core types
 			for (CpuMask::const_iterator it = eCoreMask.begin(); it != eCoreMask.end(); ++it) {
@@ -1688,13 +2173,27 @@ inline bool initCpuTopology(CpuTopology& cpuTopo)
 				}
 			}
 		}
-		// Fallback: if either sysfs paths are unavailable, detect both core type per-CPU
+		/*
+			Fallback: if either sysfs paths are unavailable, detect both core type by CPUID leaf 0x1A
+			SMT siblings have the same core type, so migrate only once per physical core
+		*/
 		if (!hasPCoreSysfs || !hasECoreSysfs) {
 			cpu_set_t originalMask;
 			CPU_ZERO(&originalMask);
 			if (sched_getaffinity(0, sizeof(cpu_set_t), &originalMask) == 0) {
+				std::vector<bool> done(logicalCpuNum);
 				for (uint32_t cpu = 0; cpu < logicalCpuNum; cpu++) {
-					cpuTopo.logicalCpus_[cpu].coreType = impl::setAffinityAndGetCoreType(cpu);
+					if (done[cpu]) continue;
+					const CoreType coreType = impl::setAffinityAndGetCoreType(cpu);
+					cpuTopo.logicalCpus_[cpu].coreType = coreType;
+					const CpuMask& siblings = cpuTopo.logicalCpus_[cpu].getSiblings();
+					for (CpuMask::const_iterator it = siblings.begin(); it != siblings.end(); ++it) {
+						const uint32_t idx = *it;
+						if (idx < logicalCpuNum) {
+							cpuTopo.logicalCpus_[idx].coreType = coreType;
+							done[idx] = true;
+						}
+					}
 				}
 				sched_setaffinity(0, sizeof(cpu_set_t), &originalMask);
 			}
@@ -1702,26 +2201,368 @@ inline bool initCpuTopology(CpuTopology& cpuTopo)
 	}
 
 	// Read coherency line size
-	cpuTopo.lineSize_ = readIntFromFile("/sys/devices/system/cpu/cpu0/cache/index0/coherency_line_size");
+	snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu0/cache/index0/coherency_line_size", sysfsRoot);
+	cpuTopo.lineSize_ = readIntFromFile(path);
 
 	cpuTopo.physicalCoreNum_ = maxPhisicalIdx + 1;
+	initNumaNode(cpuTopo.nodes_, cpuTopo.logicalCpus_, sysfsRoot);
 	return true;
 }
 #else // Other OS (e.g., macOS)
-inline bool initCpuTopology(CpuTopology& cpuTopo)
+inline bool initCpuTopology(CpuTopology& cpuTopo, const char *sysfsRoot)
 {
 	// CPU topology detection not yet implemented
 	(void)cpuTopo;
+	(void)sysfsRoot;
 	return false;
 }
 #endif // _WIN32 / __linux__ / other OS
 
 } // namespace impl
-#endif // XBYAK_CPU_CACHE
 
-class Clock {
+namespace impl {
+
+#ifdef _WIN32
+// all CPUs in mask must belong to one processor group
+inline bool setThreadAffinity(HANDLE h, const CpuMask& mask)
+{
+	if (mask.empty()) return false;
+	const WORD groupNum = GetActiveProcessorGroupCount();
+	uint32_t base = 0;
+	for (WORD g = 0; g < groupNum; g++) {
+		const uint32_t n = GetActiveProcessorCount(g);
+		GROUP_AFFINITY ga;
+		memset(&ga, 0, sizeof(ga));
+		ga.Group = g;
+		for (CpuMask::const_iterator it = mask.begin(); it != mask.end(); ++it) {
+			const uint32_t idx = *it;
+			if (idx < base || idx >= base + n) continue;
+			ga.Mask |= KAFFINITY(1) << (idx - base);
+		}
+		if (ga.Mask) {
+			if (popcnt(uint64_t(ga.Mask)) != mask.size()) return false;
+			return SetThreadGroupAffinity(h, &ga, NULL) != 0;
+		}
+		base += n;
+	}
+	return false;
+}
+#elif defined(__linux__)
+// cpu_set_t allocated by CPU_ALLOC
+class CpuSet {
+	cpu_set_t *p_;
+	size_t size_;
+	CpuSet(const CpuSet&);
+	void operator=(const CpuSet&);
 public:
-	static inline uint64_t getRdtsc()
+	// for the logical CPUs [0, n)
+	explicit CpuSet(size_t n) : p_(CPU_ALLOC(n)), size_(CPU_ALLOC_SIZE(n)) {}
+	~CpuSet() { if (p_) CPU_FREE(p_); }
+	cpu_set_t *get() const { return p_; }
+	size_t getSize() const { return size_; }
+};
+
+inline size_t getCpuSetNum(const CpuMask& mask)
+{
+	size_t n = CPU_SETSIZE;
+	if (!mask.empty()) {
+		uint32_t last = 0;
+		for (CpuMask::const_iterator it = mask.begin(); it != mask.end(); ++it) last = *it;
+		if (last >= n) n = last + 1;
+	}
+	return n;
+}
+#endif
+
+inline int getCoreTypeRank(CoreType type)
+{
+	switch (type) {
+	case Performance: return 0;
+	case Standard: return 1;
+	case Efficient: return 3;
+	default: return 2;
+	}
+}
+
+struct CpuOrder {
+	uint32_t smtRank; // position in the SMT siblings
+	int coreTypeRank;
+	uint32_t l3; // the first cpu sharing L3
+	uint32_t l2; // the first cpu sharing L2
+	uint32_t cpuIdx;
+	bool operator<(const CpuOrder& rhs) const
+	{
+		if (smtRank != rhs.smtRank) return smtRank < rhs.smtRank;
+		if (coreTypeRank != rhs.coreTypeRank) return coreTypeRank < rhs.coreTypeRank;
+		if (l3 != rhs.l3) return l3 < rhs.l3;
+		if (l2 != rhs.l2) return l2 < rhs.l2;
+		return cpuIdx < rhs.cpuIdx;
+	}
+};
+
+inline uint32_t getFirstCpu(const CpuMask& mask, uint32_t cpuIdx)
+{
+	return mask.empty() ? cpuIdx : *mask.begin();
+}
+
+} // impl
+
+#ifdef __linux__
+/*
+	convert mask to set of setSize bytes (e.g. sizeof(cpu_set_t) or CPU_ALLOC_SIZE(n))
+	return false if mask is empty or has an index which set can't hold
+*/
+inline bool toCpuSet(cpu_set_t *set, size_t setSize, const CpuMask& mask)
+{
+	if (set == 0 || mask.empty()) return false;
+	CPU_ZERO_S(setSize, set);
+#if XBYAK_CPUMASK_COMPACT == 0
+	const size_t n = mask.getWordNum();
+	const uint64_t *w = mask.getWords();
+	if ((n - 1) * 64 + impl::bsr64(w[n - 1]) >= setSize * 8) return false;
+	memcpy(set, w, (std::min)(n * sizeof(uint64_t), setSize));
+#else
+	for (CpuMask::const_iterator it = mask.begin(); it != mask.end(); ++it) {
+		if (*it >= setSize * 8) return false;
+		CPU_SET_S(*it, setSize, set);
+	}
+#endif
+	return true;
+}
+
+// convert set of setSize bytes to mask
+inline bool fromCpuSet(CpuMask& mask, const cpu_set_t *set, size_t setSize)
+{
+	mask.clear();
+	if (set == 0) return false;
+#if XBYAK_CPUMASK_COMPACT == 0
+	std::vector<uint64_t> w((setSize + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	if (!w.empty()) memcpy(&w[0], set, setSize);
+	return mask.setWords(w.empty() ? 0 : &w[0], w.size());
+#else
+	for (uint32_t i = 0; i < setSize * 8; i++) {
+		if (CPU_ISSET_S(i, setSize, set) && !mask.append(i)) return false;
+	}
+	return true;
+#endif
+}
+#endif
+
+/*
+	pin the current thread to the logical CPUs in mask
+	on Windows, the CPUs must belong to one processor group
+*/
+inline bool setAffinity(const CpuMask& mask)
+{
+#ifdef _WIN32
+	return impl::setThreadAffinity(GetCurrentThread(), mask);
+#elif defined(__linux__)
+	impl::CpuSet set(impl::getCpuSetNum(mask));
+	if (!toCpuSet(set.get(), set.getSize(), mask)) return false;
+	return sched_setaffinity(0, set.getSize(), set.get()) == 0;
+#else
+	(void)mask;
+	return false;
+#endif
+}
+
+// get the logical CPUs where the current thread can run
+inline bool getAffinity(CpuMask& mask)
+{
+	mask.clear();
+#ifdef _WIN32
+	GROUP_AFFINITY ga;
+	if (!GetThreadGroupAffinity(GetCurrentThread(), &ga)) return false;
+	uint32_t base = 0;
+	for (WORD g = 0; g < ga.Group; g++) base += GetActiveProcessorCount(g);
+	for (uint32_t i = 0; i < sizeof(KAFFINITY) * 8; i++) {
+		if ((ga.Mask & (KAFFINITY(1) << i)) && !mask.append(base + i)) return false;
+	}
+	return true;
+#elif defined(__linux__)
+	// the kernel returns EINVAL if the set is smaller than its cpumask
+	for (size_t n = CPU_SETSIZE; n <= (size_t(1) << 20); n *= 2) {
+		impl::CpuSet set(n);
+		if (set.get() == 0) return false;
+		if (sched_getaffinity(0, set.getSize(), set.get()) == 0) return fromCpuSet(mask, set.get(), set.getSize());
+		if (errno != EINVAL) return false;
+	}
+	return false;
+#else
+	return false;
+#endif
+}
+
+#ifdef XBYAK_UTIL_HAS_THREAD
+// pin t to the logical CPUs in mask
+inline bool setAffinity(std::thread& t, const CpuMask& mask)
+{
+#ifdef _WIN32
+	return impl::setThreadAffinity(t.native_handle(), mask);
+#elif defined(__linux__)
+	impl::CpuSet set(impl::getCpuSetNum(mask));
+	if (!toCpuSet(set.get(), set.getSize(), mask)) return false;
+	return pthread_setaffinity_np(t.native_handle(), set.getSize(), set.get()) == 0;
+#else
+	(void)t;
+	(void)mask;
+	return false;
+#endif
+}
+#endif
+
+/*
+	select n logical CPUs for n threads (all CPUs if n == 0 or n is too large)
+	- one CPU per physical core before SMT siblings
+	- P-cores before E-cores on hybrid systems
+	- consecutive CPUs share L3 and L2 as much as possible
+*/
+inline std::vector<uint32_t> selectCpus(const CpuTopology& topo, size_t n = 0)
+{
+	const uint32_t cpuNum = uint32_t(topo.getLogicalCpuNum());
+	std::vector<impl::CpuOrder> v(cpuNum);
+	for (uint32_t i = 0; i < cpuNum; i++) {
+		const LogicalCpu& cpu = topo.getLogicalCpu(i);
+		impl::CpuOrder& o = v[i];
+		o.smtRank = 0;
+		const CpuMask& siblings = cpu.getSiblings();
+		for (CpuMask::const_iterator it = siblings.begin(); it != siblings.end() && *it < i; ++it) {
+			o.smtRank++;
+		}
+		o.coreTypeRank = impl::getCoreTypeRank(cpu.coreType);
+		o.l3 = impl::getFirstCpu(cpu.cache[L3].sharedCpuIndices, i);
+		o.l2 = impl::getFirstCpu(cpu.cache[L2].sharedCpuIndices, i);
+		o.cpuIdx = i;
+	}
+	std::sort(v.begin(), v.end());
+	if (n == 0 || n > cpuNum) n = cpuNum;
+	std::vector<uint32_t> ret(n);
+	for (size_t i = 0; i < n; i++) ret[i] = v[i].cpuIdx;
+	return ret;
+}
+
+struct WorkRange {
+	uint32_t cpuIdx; // logical CPU to run
+	size_t begin;
+	size_t end; // [begin, end) of the work items
+};
+
+/*
+	split itemNum work items into threadNum contiguous ranges on the CPUs by selectCpus()
+	adjacent ranges are assigned to CPUs sharing caches
+	threadNum = 0 means all CPUs
+*/
+inline std::vector<WorkRange> partitionWork(const CpuTopology& topo, size_t itemNum, size_t threadNum = 0)
+{
+	const std::vector<uint32_t> cpus = selectCpus(topo, threadNum);
+	const size_t n = cpus.size();
+	std::vector<WorkRange> ret(n);
+	const size_t q = itemNum / n;
+	const size_t r = itemNum % n;
+	size_t begin = 0;
+	for (size_t i = 0; i < n; i++) {
+		const size_t size = q + (i < r ? 1 : 0);
+		ret[i].cpuIdx = cpus[i];
+		ret[i].begin = begin;
+		ret[i].end = begin + size;
+		begin += size;
+	}
+	return ret;
+}
+
+struct CacheBlocking {
+	CacheBlocking() : kc(0), mc(0), nc(0), cacheSize() {}
+	size_t kc; // depth of the blocks (a multiple of the elements in a cache line if possible)
+	size_t mc; // rows of the block of A kept in L2 (a multiple of mr)
+	size_t nc; // columns of the panel of B kept in L3 (a multiple of nr)
+	size_t cacheSize[3]; // bytes of L1d, L2 and L3 which a thread can use for the blocks
+};
+
+namespace impl {
+
+/*
+	bytes of c which a thread can use for the blocks
+	reservedWays ways are kept for the streams which are not blocked
+	the rest is divided among sharedNum threads
+*/
+inline size_t getBlockingCacheSize(const CpuCache& c, uint32_t reservedWays, size_t sharedNum)
+{
+	const uint32_t ways = c.associativity;
+	const size_t size = ways > reservedWays ? c.size / ways * (ways - reservedWays) : c.size / 2;
+	return size / sharedNum;
+}
+
+inline size_t roundDownMultiple(size_t x, size_t n)
+{
+	return x < n ? n : x - x % n;
+}
+
+} // impl
+
+/*
+	blocking parameters for a kernel which updates an mr x nr register tile
+	by reading mr elements of A and nr elements of B per step (e.g. C += A * B)
+	elemSize ; bytes of an element
+	streamNum ; number of arrays which the kernel accesses (e.g. 3 for A, B and C)
+	threadNum ; number of threads on the CPUs by selectCpus() (0 means all CPUs)
+	- kc ; the mr x kc panel of A and the kc x nr panel of B fit in L1d
+	- mc ; the mc x kc block of A fits in L2 beside the kc x nr panel of B
+	- nc ; the kc x nc panel of B fits in L3 beside the mc x kc block of A
+	one way of each cache is kept for every stream except A and B (at least one)
+	and a cache shared by k of the threads is divided by k.
+	the smallest cache among the CPUs is used on hybrid systems.
+*/
+inline CacheBlocking getCacheBlocking(const CpuTopology& topo, size_t elemSize, size_t streamNum, size_t mr, size_t nr, size_t threadNum = 0)
+{
+	CacheBlocking ret;
+	if (elemSize == 0 || mr == 0 || nr == 0) XBYAK_THROW_RET(ERR_BAD_PARAMETER, ret)
+	const uint32_t reservedWays = streamNum > 3 ? uint32_t(streamNum - 2) : 1;
+	const std::vector<uint32_t> cpus = selectCpus(topo, threadNum);
+	const CacheType tbl[] = { L1d, L2, L3 };
+	for (int i = 0; i < 3; i++) {
+		size_t minSize = 0;
+		for (size_t j = 0; j < cpus.size(); j++) {
+			const CpuCache& c = topo.getCache(cpus[j], tbl[i]);
+			if (c.size == 0) continue;
+			size_t sharedNum = 0;
+			for (size_t k = 0; k < cpus.size(); k++) {
+				if (cpus[k] == cpus[j] || c.sharedCpuIndices.contains(cpus[k])) sharedNum++;
+			}
+			const size_t size = impl::getBlockingCacheSize(c, reservedWays, sharedNum);
+			if (minSize == 0 || size < minSize) minSize = size;
+		}
+		// use the inner level if the cache does not exist
+		ret.cacheSize[i] = minSize == 0 && i > 0 ? ret.cacheSize[i - 1] : minSize;
+	}
+	const size_t lineSize = topo.getLineSize() ? topo.getLineSize() : 64;
+	const size_t lineElemNum = lineSize >= elemSize ? lineSize / elemSize : 1;
+	const size_t kc = ret.cacheSize[0] / ((mr + nr) * elemSize);
+	ret.kc = kc < lineElemNum ? (kc ? kc : 1) : impl::roundDownMultiple(kc, lineElemNum);
+	const size_t panelB = ret.kc * nr * elemSize;
+	const size_t rowSize = ret.kc * elemSize;
+	ret.mc = impl::roundDownMultiple(ret.cacheSize[1] > panelB ? (ret.cacheSize[1] - panelB) / rowSize : 0, mr);
+	const size_t blockA = ret.mc * rowSize;
+	ret.nc = impl::roundDownMultiple(ret.cacheSize[2] > blockA ? (ret.cacheSize[2] - blockA) / rowSize : 0, nr);
+	return ret;
+}
+
+#endif // XBYAK_CPU_CACHE
+
+class Clock {
+	static uint32_t getMaxExtendedLeaf()
+	{
+		uint32_t data[4];
+		Cpu::getCpuid(0x80000000, data);
+		return data[0];
+	}
+	static bool hasRdtscp()
+	{
+		uint32_t data[4] = {};
+		if (getMaxExtendedLeaf() >= 0x80000001) Cpu::getCpuid(0x80000001, data);
+		return (data[3] & (1U << 27)) != 0;
+	}
+public:
+	static inline uint64_t getRdtsc()
 	{
 #ifdef XBYAK_INTEL_CPU_SPECIFIC
 	#ifdef _MSC_VER
@@ -1736,26 +2577,367 @@ public:
 		return 0;
 #endif
 	}
-	Clock()
+	/*
+		lfence; rdtsc; lfence
+		rdtsc is executed after the preceding instructions finish
+		and the following instructions start after rdtsc
+	*/
+	static inline uint64_t getRdtscBegin()
+	{
+#ifdef XBYAK_INTEL_CPU_SPECIFIC
+	#ifdef _MSC_VER
+		_mm_lfence();
+		const uint64_t t = __rdtsc();
+		_mm_lfence();
+		return t;
+	#else
+		uint32_t eax, edx;
+		__asm__ volatile("lfence\nrdtsc\nlfence" : "=a"(eax), "=d"(edx) : : "memory");
+		return ((uint64_t)edx << 32) | eax;
+	#endif
+#else
+		return 0;
+#endif
+	}
+	/*
+		rdtscp; lfence
+		rdtscp waits for the preceding instructions
+		use lfence; rdtsc; lfence if rdtscp is not supported
+	*/
+	static inline uint64_t getRdtscEnd()
+	{
+#ifdef XBYAK_INTEL_CPU_SPECIFIC
+		static const bool useRdtscp = hasRdtscp();
+		if (!useRdtscp) return getRdtscBegin();
+	#ifdef _MSC_VER
+		unsigned int aux;
+		const uint64_t t = __rdtscp(&aux);
+		_mm_lfence();
+		return t;
+	#else
+		uint32_t eax, edx;
+		__asm__ volatile("rdtscp\nlfence" : "=a"(eax), "=d"(edx) : : "ecx", "memory");
+		return ((uint64_t)edx << 32) | eax;
+	#endif
+#else
+		return 0;
+#endif
+	}
+	// monotonic time in nsec (0 if not available)
+	static inline uint64_t getMonotonicNs()
+	{
+#ifdef XBYAK_UTIL_HAS_THREAD
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#elif !defined(_WIN32)
+		struct timespec ts;
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) return 0;
+		return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+		return 0;
+#endif
+	}
+	// TSC keeps a constant rate in all ACPI P-, C-, and T-states
+	static bool isInvariantTsc()
+	{
+		if (getMaxExtendedLeaf() < 0x80000007) return false;
+		uint32_t data[4];
+		Cpu::getCpuid(0x80000007, data);
+		return (data[3] & (1U << 8)) != 0;
+	}
+	/*
+		TSC frequency in Hz by cpuid (0 if not available)
+		leaf 0x15 ; TSC/crystal clock ratio and the crystal clock frequency
+		leaf 0x16 ; the base frequency if the crystal clock frequency is not enumerated
+	*/
+	static uint64_t getTscHzByCpuid()
+	{
+#ifdef XBYAK_INTEL_CPU_SPECIFIC
+		uint32_t data[4];
+		Cpu::getCpuid(0, data);
+		const uint32_t maxLeaf = data[0];
+		if (maxLeaf < 0x15) return 0;
+		Cpu::getCpuid(0x15, data);
+		const uint32_t den = data[0], num = data[1], crystalHz = data[2];
+		if (den == 0 || num == 0) return 0;
+		if (crystalHz) return uint64_t(crystalHz) * num / den;
+		if (maxLeaf < 0x16) return 0;
+		Cpu::getCpuid(0x16, data);
+		const uint32_t baseMHz = data[0] & 0xffff;
+		return uint64_t(baseMHz) * 1000000;
+#else
+		return 0;
+#endif
+	}
+	// measure TSC frequency in Hz against the monotonic clock for msec (0 if failed)
+	static uint64_t calibrateTscHz(uint32_t msec = 10)
+	{
+		const uint64_t t0 = getMonotonicNs();
+		const uint64_t c0 = getRdtscBegin();
+		if (t0 == 0 || c0 == 0) return 0;
+		uint64_t t1, c1;
+		do {
+			t1 = getMonotonicNs();
+			c1 = getRdtscEnd();
+		} while (t1 - t0 < uint64_t(msec) * 1000000);
+		return uint64_t((c1 - c0) * 1e9 / (t1 - t0));
+	}
+	/*
+		TSC frequency in Hz
+		getTscHzByCpuid() if the TSC is invariant and the leaves are available, otherwise calibrateTscHz()
+		it is determined once (0 if not available)
+	*/
+	static uint64_t getTscHz()
+	{
+		static const uint64_t hz = detectTscHz();
+		return hz;
+	}
+	// convert clk (TSC count) into nsec
+	static double toNs(uint64_t clk)
+	{
+		const uint64_t hz = getTscHz();
+		return hz ? clk * 1e9 / hz : 0;
+	}
+	// use getRdtscBegin()/getRdtscEnd() in begin()/end() if fenced is true
+	explicit Clock(bool fenced = false)
 		: clock_(0)
 		, count_(0)
+		, fenced_(fenced)
 	{
 	}
 	void begin()
 	{
-		clock_ -= getRdtsc();
+		clock_ -= fenced_ ? getRdtscBegin() : getRdtsc();
 	}
 	void end()
 	{
-		clock_ += getRdtsc();
+		clock_ += fenced_ ? getRdtscEnd() : getRdtsc();
 		count_++;
 	}
 	int getCount() const { return count_; }
 	uint64_t getClock() const { return clock_; }
+	// the total time in nsec
+	double getNs() const { return toNs(clock_); }
 	void clear() { count_ = 0; clock_ = 0; }
 private:
+	static uint64_t detectTscHz()
+	{
+		if (isInvariantTsc()) {
+			const uint64_t hz = getTscHzByCpuid();
+			if (hz) return hz;
+		}
+		return calibrateTscHz();
+	}
 	uint64_t clock_;
 	int count_;
+	bool fenced_;
+};
+
+/*
+	hardware performance counters of the calling thread (Linux perf_event_open)
+	a counter which can't be opened (no PMU, perf_event_paranoid, ...) is not available
+	and its value is 0
+	the values are read by rdpmc if the kernel allows it, otherwise by read()
+
+	PerfCounter pc;
+	for (...) {
+		pc.begin();
+		f();
+		pc.end();
+	}
+	pc.put("f");
+*/
+class PerfCounter {
+public:
+	enum Type {
+		Instructions, // retired instructions
+		Cycles, // core cycles
+		CacheMisses, // last level cache misses
+		BranchMisses, // mispredicted branches
+		TypeNum
+	};
+	struct Result {
+		int count; // the number of calls of end()
+		uint64_t clk; // TSC
+		uint64_t v[TypeNum];
+		Result() : count(0), clk(0) { memset(v, 0, sizeof(v)); }
+		double perCall(int type) const { return count ? v[type] / double(count) : 0; }
+	};
+	static const char *getName(int type)
+	{
+		static const char *tbl[] = { "inst", "cycle", "cache-miss", "branch-miss" };
+		return (0 <= type && type < TypeNum) ? tbl[type] : "unknown";
+	}
+	PerfCounter()
+	{
+		for (int i = 0; i < TypeNum; i++) {
+			fd_[i] = -1;
+			page_[i] = 0;
+		}
+		open();
+	}
+	~PerfCounter() { close(); }
+	bool isAvailable(int type) const { return fd_[type] >= 0; }
+	// true if at least one counter is available
+	bool isAvailable() const
+	{
+		for (int i = 0; i < TypeNum; i++) {
+			if (isAvailable(i)) return true;
+		}
+		return false;
+	}
+	// true if the counter is read by rdpmc
+	bool isRdpmc(int type) const { return page_[type] != 0; }
+	// current values of the counters
+	void read(uint64_t v[TypeNum]) const
+	{
+		for (int i = 0; i < TypeNum; i++) v[i] = readCounter(i);
+	}
+	// start the measurement of region (regions can be nested)
+	void begin(size_t region = 0)
+	{
+		if (region >= regionList_.size()) regionList_.resize(region + 1);
+		Region& r = regionList_[region];
+		read(r.begin);
+		r.beginClk = Clock::getRdtsc();
+	}
+	void end(size_t region = 0)
+	{
+		uint64_t v[TypeNum];
+		read(v);
+		const uint64_t clk = Clock::getRdtsc();
+		assert(region < regionList_.size());
+		Region& r = regionList_[region];
+		r.result.count++;
+		r.result.clk += clk - r.beginClk;
+		for (int i = 0; i < TypeNum; i++) r.result.v[i] += v[i] - r.begin[i];
+	}
+	size_t getRegionNum() const { return regionList_.size(); }
+	const Result& getResult(size_t region = 0) const
+	{
+		static const Result empty;
+		return region < regionList_.size() ? regionList_[region].result : empty;
+	}
+	int getCount(size_t region = 0) const { return getResult(region).count; }
+	uint64_t get(int type, size_t region = 0) const { return getResult(region).v[type]; }
+	void clear() { regionList_.clear(); }
+	// print the values per call
+	void put(const char *label = NULL, size_t region = 0) const
+	{
+		const Result& r = getResult(region);
+		if (label) printf("%s: ", label);
+		printf("clk %.2f", r.count ? r.clk / double(r.count) : 0);
+		for (int i = 0; i < TypeNum; i++) {
+			if (isAvailable(i)) printf(" %s %.2f", getName(i), r.perCall(i));
+		}
+		printf("\n");
+	}
+private:
+	struct Region {
+		uint64_t begin[TypeNum];
+		uint64_t beginClk;
+		Result result;
+		Region() : beginClk(0) { memset(begin, 0, sizeof(begin)); }
+	};
+	int fd_[TypeNum];
+	void *page_[TypeNum]; // perf_event_mmap_page if rdpmc is available
+	std::vector<Region> regionList_;
+	PerfCounter(const PerfCounter&);
+	void operator=(const PerfCounter&);
+#ifdef XBYAK_USE_PERF
+	static uint64_t rdpmc(uint32_t idx)
+	{
+#ifdef XBYAK_INTEL_CPU_SPECIFIC
+		uint32_t eax, edx;
+		__asm__ volatile("rdpmc" : "=a"(eax), "=d"(edx) : "c"(idx));
+		return ((uint64_t)edx << 32) | eax;
+#else
+		(void)idx;
+		return 0;
+#endif
+	}
+	// return false if rdpmc can't be used now
+	static bool readByRdpmc(uint64_t& v, const void *p)
+	{
+		const volatile perf_event_mmap_page *pc = (const volatile perf_event_mmap_page*)p;
+		uint32_t seq;
+		uint64_t count;
+		do {
+			seq = pc->lock;
+			__asm__ volatile("" ::: "memory");
+			const uint32_t idx = pc->index;
+			if (!pc->cap_user_rdpmc || idx == 0) return false;
+			const uint32_t width = pc->pmc_width;
+			count = pc->offset;
+			// sign extend the width-bit counter
+			uint64_t pmc = rdpmc(idx - 1) << (64 - width);
+			count += uint64_t(int64_t(pmc) >> (64 - width));
+			__asm__ volatile("" ::: "memory");
+		} while (pc->lock != seq);
+		v = count;
+		return true;
+	}
+#endif
+	uint64_t readCounter(int type) const
+	{
+		if (fd_[type] < 0) return 0;
+#ifdef XBYAK_USE_PERF
+		uint64_t v = 0;
+		if (page_[type] && readByRdpmc(v, page_[type])) return v;
+		if (::read(fd_[type], &v, sizeof(v)) != sizeof(v)) return 0;
+		return v;
+#else
+		return 0;
+#endif
+	}
+	void open()
+	{
+#ifdef XBYAK_USE_PERF
+		static const uint64_t configTbl[] = {
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_CACHE_MISSES,
+			PERF_COUNT_HW_BRANCH_MISSES,
+		};
+		const size_t pageSize = inner::getPageSize();
+		int leader = -1;
+		for (int i = 0; i < TypeNum; i++) {
+			struct perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = configTbl[i];
+			attr.disabled = leader < 0;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			// the counters in a group are scheduled together
+			int fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+			if (fd < 0) continue;
+			fd_[i] = fd;
+			if (leader < 0) leader = fd;
+			void *p = mmap(NULL, pageSize, PROT_READ, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED) continue;
+			if (((const perf_event_mmap_page*)p)->cap_user_rdpmc) {
+				page_[i] = p;
+			} else {
+				munmap(p, pageSize);
+			}
+		}
+		if (leader >= 0) ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+	void close()
+	{
+#ifdef XBYAK_USE_PERF
+		const size_t pageSize = inner::getPageSize();
+		// close the members before the leader
+		for (int i = TypeNum - 1; i >= 0; i--) {
+			if (page_[i]) munmap(page_[i], pageSize);
+			if (fd_[i] >= 0) ::close(fd_[i]);
+			page_[i] = 0;
+			fd_[i] = -1;
+		}
+#endif
+	}
 };
 
 #ifdef XBYAK64
@@ -2311,18 +3493,1735 @@ public:
 		startAddr_ = endAddr;
 	}
 };
-#endif // XBYAK_ONLY_CLASS_CPU
-
-} } // end of util
 
-#if XBYAK_CPUMASK_COMPACT == 1 && __cplusplus >= 201103
-
-namespace std {
+/*
+	bring the code [addr, addr + size) into the cache before the first call
+	read each cache line and issue PREFETCHIT0 for it if the CPU supports PREFETCHITI (64-bit only)
+	call it after ready() (the lines out of rel32 range of the prefetch code are only read)
+	@note it is for one-time use at startup, not for a hot path ;
+	with PREFETCHITI each call generates temporary prefetch code (mmap, mprotect, and munmap)
+	because prefetchit0 needs the rip-relative address of each line
+*/
+inline void warmCode(const void *addr, size_t size)
+{
+	if (size == 0) return;
+	const size_t lineSize = 64;
+	const uint8_t *top = (const uint8_t*)(size_t(addr) & ~(lineSize - 1));
+	const uint8_t *end = (const uint8_t*)addr + size;
+	for (const uint8_t *p = top; p < end; p += lineSize) {
+		(void)*(const volatile uint8_t*)p;
+	}
+#if defined(XBYAK64) && defined(XBYAK_INTEL_CPU_SPECIFIC)
+	static const bool hasPrefetchITI = Cpu::getInstance().has(Cpu::tPREFETCHITI);
+	if (!hasPrefetchITI) return;
+	const size_t prefetchSize = 7; // prefetchit0 [rip + disp32]
+	CodeGenerator code(((end - top) / lineSize + 1) * prefetchSize + 1);
+	for (const uint8_t *p = top; p < end; p += lineSize) {
+		if (!inner::IsInInt32(size_t(p) - size_t(code.getCurr() + prefetchSize))) continue;
+		code.prefetchit0(code.ptr[code.rip + p]);
+	}
+	code.ret();
+	code.getCode<void (*)()>()();
+#endif
+}
 
-template<>
-struct hash<Xbyak::util::CpuMask> {
-	size_t operator()(const Xbyak::util::CpuMask& m) const noexcept {
-		return std::hash<uint64_t>{}(m.to_u64());
+/*
+	content-addressed cache of executable code
+	byte-identical functions generated in AutoGrow mode share one read/exec copy
+	@note not thread-safe
+*/
+class CodeCache {
+	struct Entry {
+		uint8_t *addr;
+		size_t size;
+		size_t refCount;
+	};
+	typedef XBYAK_STD_UNORDERED_MULTIMAP<uint64_t, Entry> HashList;
+	typedef XBYAK_STD_UNORDERED_MAP<const uint8_t*, uint64_t> AddrList;
+	// free the buffer unless it is registered
+	struct Guard {
+		Allocator *alloc;
+		uint8_t *p;
+		Guard(Allocator *alloc, uint8_t *p) : alloc(alloc), p(p) {}
+		~Guard() { if (p) alloc->free(p); }
+	};
+#ifdef XBYAK_USE_MMAP_ALLOCATOR
+	MmapAllocator defaultAllocator_;
+#else
+	Allocator defaultAllocator_;
+#endif
+	Allocator *alloc_;
+	HashList hashList_;
+	AddrList addrList_;
+	size_t codeSize_;
+	CodeCache(const CodeCache&);
+	void operator=(const CodeCache&);
+	void freeEntry(const Entry& e)
+	{
+		if (alloc_->useProtect()) CodeArray::protect(e.addr, e.size, CodeArray::PROTECT_RW);
+		alloc_->free(e.addr);
+		codeSize_ -= e.size;
+	}
+public:
+	explicit CodeCache(Allocator *allocator = 0)
+		: alloc_(allocator ? allocator : (Allocator*)&defaultAllocator_)
+		, codeSize_(0)
+	{
+	}
+	~CodeCache()
+	{
+		for (HashList::const_iterator i = hashList_.begin(), ie = hashList_.end(); i != ie; ++i) {
+			freeEntry(i->second);
+		}
+	}
+	/*
+		return an executable copy of the code generated by gen in AutoGrow mode
+		the same address is returned while identical code is acquired and not released
+		gen does not need to call ready()
+	*/
+	const uint8_t *acquire(const CodeGenerator& gen)
+	{
+		if (!gen.isAutoGrow()) XBYAK_THROW_RET(ERR_BAD_PARAMETER, 0)
+		if (gen.hasUndefinedLabel()) XBYAK_THROW_RET(ERR_LABEL_IS_NOT_FOUND, 0)
+		const size_t size = gen.getSize();
+		const uint64_t hash = gen.getCodeHash();
+		std::vector<uint8_t> buf(size);
+		std::pair<HashList::iterator, HashList::iterator> range = hashList_.equal_range(hash);
+		for (HashList::iterator i = range.first; i != range.second; ++i) {
+			Entry& e = i->second;
+			if (e.size != size) continue;
+			if (size > 0) {
+				// compare the code as if it were placed at e.addr
+				gen.copyTo(&buf[0], e.addr);
+				if (memcmp(&buf[0], e.addr, size) != 0) continue;
+			}
+			e.refCount++;
+			return e.addr;
+		}
+		Entry e;
+		e.size = (std::max<size_t>)(size, 1);
+		e.refCount = 1;
+		e.addr = alloc_->alloc(e.size);
+		if (e.addr == 0) XBYAK_THROW_RET(ERR_CANT_ALLOC, 0)
+		Guard guard(alloc_, e.addr);
+		gen.copyTo(e.addr);
+#ifdef XBYAK_NO_EXCEPTION
+		if (GetError()) return 0;
+#endif
+		if (alloc_->useProtect() && !CodeArray::protect(e.addr, e.size, CodeArray::PROTECT_RE)) XBYAK_THROW_RET(ERR_CANT_PROTECT, 0)
+		hashList_.insert(HashList::value_type(hash, e));
+		addrList_.insert(AddrList::value_type(e.addr, hash));
+		codeSize_ += e.size;
+		guard.p = 0;
+		return e.addr;
+	}
+	template<class F>
+	F acquire(const CodeGenerator& gen)
+	{
+		return reinterpret_cast<F>(const_cast<uint8_t*>(acquire(gen)));
+	}
+	// decrement the reference count of the code returned by acquire() and free it if it becomes zero
+	void release(const void *p)
+	{
+		AddrList::iterator a = addrList_.find(static_cast<const uint8_t*>(p));
+		if (a == addrList_.end()) XBYAK_THROW(ERR_BAD_PARAMETER)
+		std::pair<HashList::iterator, HashList::iterator> range = hashList_.equal_range(a->second);
+		for (HashList::iterator i = range.first; i != range.second; ++i) {
+			Entry& e = i->second;
+			if (e.addr != p) continue;
+			if (--e.refCount == 0) {
+				freeEntry(e);
+				hashList_.erase(i);
+				addrList_.erase(a);
+			}
+			return;
+		}
+	}
+	// the number of distinct functions in the cache
+	size_t getEntryNum() const { return hashList_.size(); }
+	// the total bytes of the code in the cache
+	size_t getCodeSize() const { return codeSize_; }
+	// the reference count of the code returned by acquire()
+	size_t getRefCount(const void *p) const
+	{
+		AddrList::const_iterator a = addrList_.find(static_cast<const uint8_t*>(p));
+		if (a == addrList_.end()) return 0;
+		std::pair<HashList::const_iterator, HashList::const_iterator> range = hashList_.equal_range(a->second);
+		for (HashList::const_iterator i = range.first; i != range.second; ++i) {
+			if (i->second.addr == p) return i->second.refCount;
+		}
+		return 0;
+	}
+};
+
+/*
+	entry points of code shared between processes
+	"size <n>\n" followed by "<name> <offset>\n" for each entry
+*/
+class CodeManifest {
+	typedef std::vector<std::pair<std::string, size_t> > EntryList;
+	EntryList entryList_;
+	size_t size_;
+public:
+	CodeManifest() : size_(0) {}
+	void clear() { entryList_.clear(); size_ = 0; }
+	// the size of the code
+	void setSize(size_t size) { size_ = size; }
+	size_t getSize() const { return size_; }
+	void append(const std::string& name, size_t offset)
+	{
+		if (name.empty() || name.find_first_of(" \n") != std::string::npos || getOffset(name) != size_t(-1)) XBYAK_THROW(ERR_BAD_PARAMETER)
+		entryList_.push_back(std::make_pair(name, offset));
+	}
+	// return size_t(-1) if not found
+	size_t getOffset(const std::string& name) const
+	{
+		for (size_t i = 0; i < entryList_.size(); i++) {
+			if (entryList_[i].first == name) return entryList_[i].second;
+		}
+		return size_t(-1);
+	}
+	size_t getEntryNum() const { return entryList_.size(); }
+	std::string getStr() const
+	{
+		std::string s = "size ";
+		appendSize(s, size_);
+		s += '\n';
+		for (size_t i = 0; i < entryList_.size(); i++) {
+			s += entryList_[i].first;
+			s += ' ';
+			appendSize(s, entryList_[i].second);
+			s += '\n';
+		}
+		return s;
+	}
+	// return false if s is invalid
+	bool setStr(const std::string& s)
+	{
+		clear();
+		size_t pos = 0;
+		bool isFirst = true;
+		while (pos < s.size()) {
+			size_t eol = s.find('\n', pos);
+			if (eol == std::string::npos) eol = s.size();
+			const std::string line = s.substr(pos, eol - pos);
+			pos = eol + 1;
+			const size_t sp = line.find(' ');
+			if (sp == 0 || sp == std::string::npos || sp + 1 == line.size()) goto ERR;
+			char *endp;
+			const unsigned long long v = strtoull(line.c_str() + sp + 1, &endp, 10);
+			if (*endp != '\0') goto ERR;
+			const std::string name = line.substr(0, sp);
+			if (isFirst) {
+				if (name != "size") goto ERR;
+				size_ = size_t(v);
+				isFirst = false;
+			} else {
+				if (getOffset(name) != size_t(-1) || v >= size_) goto ERR;
+				entryList_.push_back(std::make_pair(name, size_t(v)));
+			}
+		}
+		return true;
+	ERR:
+		clear();
+		return false;
+	}
+private:
+	static void appendSize(std::string& s, size_t v)
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%llu", (unsigned long long)v);
+		s += buf;
+	}
+};
+
+#ifdef __linux__
+/*
+	map the code in a memfd of another process (see MmapAllocator::getFd()) as read/exec
+	the code must be position independent (see CodeArray::isPositionIndependent())
+*/
+class SharedCode {
+	uint8_t *top_;
+	size_t size_;
+	SharedCode(const SharedCode&);
+	void operator=(const SharedCode&);
+public:
+	SharedCode() : top_(0), size_(0) {}
+	SharedCode(int fd, size_t size) : top_(0), size_(0) { map(fd, size); }
+	~SharedCode() { unmap(); }
+	bool map(int fd, size_t size)
+	{
+		unmap();
+		if (fd < 0 || size == 0) XBYAK_THROW_RET(ERR_BAD_PARAMETER, false)
+		void *p = mmap(NULL, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) XBYAK_THROW_RET(ERR_CANT_ALLOC, false)
+		top_ = (uint8_t*)p;
+		size_ = size;
+		return true;
+	}
+	void unmap()
+	{
+		if (top_ == 0) return;
+		munmap(top_, size_);
+		top_ = 0;
+		size_ = 0;
+	}
+	const uint8_t *getCode() const { return top_; }
+	template<class F>
+	F getCode(size_t offset = 0) const { return reinterpret_cast<F>(top_ + offset); }
+	size_t getSize() const { return size_; }
+};
+#endif
+
+#ifdef XBYAK_UTIL_HAS_THREAD
+/*
+	thread-safe cache of kernels specialized by Key
+	Code is a class derived from CodeArray, Key must be hashable by Hash
+	the cache is split into shards (each has its own mutex) and each shard evicts
+	the least recently used kernels if the total code size exceeds maxCodeSize / shardNum
+	a kernel is generated only once even if several threads miss the same key at the same time
+	an evicted kernel is alive while a returned CodePtr refers to it
+*/
+template<class Key, class Code, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key> >
+class KernelCache {
+public:
+	typedef std::shared_ptr<Code> CodePtr;
+	struct Stats {
+		uint64_t hit;
+		uint64_t miss;
+		uint64_t eviction;
+		Stats() : hit(0), miss(0), eviction(0) {}
+	};
+private:
+	typedef std::list<Key> LruList;
+	struct Node {
+		CodePtr code; // empty while it is being generated
+		typename LruList::iterator pos;
+	};
+	typedef std::unordered_map<Key, Node, Hash, KeyEqual> NodeList;
+	struct Shard {
+		mutable std::mutex m;
+		std::condition_variable cv;
+		NodeList nodeList;
+		LruList lru; // front is the most recently used
+		size_t codeSize;
+		Stats stats;
+		Shard() : codeSize(0) {}
+	};
+	// remove the pending node if the generator fails
+	struct Pending {
+		Shard& s;
+		const Key& key;
+		bool done;
+		Pending(Shard& s, const Key& key) : s(s), key(key), done(false) {}
+		~Pending()
+		{
+			if (done) return;
+			std::lock_guard<std::mutex> lk(s.m);
+			s.nodeList.erase(key);
+			s.cv.notify_all();
+		}
+	};
+	std::vector<Shard> shardTbl_;
+	size_t maxShardCodeSize_;
+	Hash hash_;
+	KernelCache(const KernelCache&);
+	void operator=(const KernelCache&);
+	Shard& getShard(const Key& key)
+	{
+		// mix the hash because the low bits also select the bucket in the shard
+		const uint64_t h = uint64_t(hash_(key)) * uint64_t(0x9e3779b97f4a7c15ull);
+		return shardTbl_[size_t(h >> 32) % shardTbl_.size()];
+	}
+	void evict(Shard& s)
+	{
+		while (s.codeSize > maxShardCodeSize_ && s.lru.size() > 1) {
+			typename NodeList::iterator i = s.nodeList.find(s.lru.back());
+			s.codeSize -= i->second.code->getSize();
+			s.nodeList.erase(i);
+			s.lru.pop_back();
+			s.stats.eviction++;
+		}
+	}
+public:
+	/*
+		@param maxCodeSize [in] upper bound of the total code size in bytes
+		@param shardNum [in] the number of shards
+	*/
+	explicit KernelCache(size_t maxCodeSize, size_t shardNum = 16)
+		: shardTbl_(shardNum == 0 ? 1 : shardNum)
+		, maxShardCodeSize_(maxCodeSize / shardTbl_.size())
+	{
+	}
+	/*
+		return the kernel for key
+		call gen(key) returning CodePtr if the kernel is not in the cache
+	*/
+	template<class F>
+	CodePtr get(const Key& key, F gen)
+	{
+		Shard& s = getShard(key);
+		std::unique_lock<std::mutex> lk(s.m);
+		for (;;) {
+			typename NodeList::iterator i = s.nodeList.find(key);
+			if (i == s.nodeList.end()) break;
+			if (i->second.code) {
+				s.stats.hit++;
+				s.lru.splice(s.lru.begin(), s.lru, i->second.pos);
+				return i->second.code;
+			}
+			// another thread is generating the kernel
+			s.cv.wait(lk);
+		}
+		s.stats.miss++;
+		s.nodeList.insert(typename NodeList::value_type(key, Node()));
+		lk.unlock();
+		Pending pending(s, key);
+		CodePtr code = gen(key);
+		if (!code) return code;
+		lk.lock();
+		Node& node = s.nodeList[key];
+		node.code = code;
+		node.pos = s.lru.insert(s.lru.begin(), key);
+		s.codeSize += code->getSize();
+		evict(s);
+		pending.done = true;
+		s.cv.notify_all();
+		return code;
+	}
+	// generate a kernel by Code(key) if it is not in the cache
+	CodePtr get(const Key& key)
+	{
+		return get(key, [](const Key& k) { return std::make_shared<Code>(k); });
+	}
+	// remove all kernels (the kernels being generated are kept)
+	void clear()
+	{
+		for (size_t i = 0; i < shardTbl_.size(); i++) {
+			Shard& s = shardTbl_[i];
+			std::lock_guard<std::mutex> lk(s.m);
+			for (typename LruList::const_iterator j = s.lru.begin(); j != s.lru.end(); ++j) {
+				s.nodeList.erase(*j);
+			}
+			s.lru.clear();
+			s.codeSize = 0;
+		}
+	}
+	// the number of cached kernels
+	size_t size() const
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < shardTbl_.size(); i++) {
+			const Shard& s = shardTbl_[i];
+			std::lock_guard<std::mutex> lk(s.m);
+			n += s.lru.size();
+		}
+		return n;
+	}
+	// the total code size of cached kernels
+	size_t getCodeSize() const
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < shardTbl_.size(); i++) {
+			const Shard& s = shardTbl_[i];
+			std::lock_guard<std::mutex> lk(s.m);
+			n += s.codeSize;
+		}
+		return n;
+	}
+	Stats getStats() const
+	{
+		Stats ret;
+		for (size_t i = 0; i < shardTbl_.size(); i++) {
+			const Shard& s = shardTbl_[i];
+			std::lock_guard<std::mutex> lk(s.m);
+			ret.hit += s.stats.hit;
+			ret.miss += s.stats.miss;
+			ret.eviction += s.stats.eviction;
+		}
+		return ret;
+	}
+};
+
+/*
+	search the fastest parameters of a kernel generator
+	the best parameters are cached by the name of the kernel and the machine type
+	(displayFamily, displayModel, and the feature bits of Cpu) so that the search runs once per machine type
+
+	Autotuner::Space space;
+	space.add("unroll", { 1, 2, 4, 8 });
+	space.add("prefetch", { 0, 256, 512 });
+	Autotuner tuner;
+	Autotuner::Param best;
+	Autotuner::CodePtr code;
+	tuner.tune(best, code, "kernel", space,
+		[](const Autotuner::Param& p) { return std::make_shared<Kernel>(p.get("unroll"), p.get("prefetch")); },
+		[&](const CodeGenerator& c) { c.getCode<void (*)(float*, size_t)>()(buf, n); });
+	code->getCode<void (*)(float*, size_t)>()(buf, n); // the fastest kernel
+*/
+class Autotuner {
+public:
+	// values of the knobs
+	class Param {
+		typedef std::vector<std::pair<std::string, int> > List;
+		List list_;
+		friend class Autotuner;
+	public:
+		void set(const std::string& name, int v)
+		{
+			for (size_t i = 0; i < list_.size(); i++) {
+				if (list_[i].first == name) {
+					list_[i].second = v;
+					return;
+				}
+			}
+			list_.push_back(std::make_pair(name, v));
+		}
+		// return def if name is not found
+		int get(const std::string& name, int def = 0) const
+		{
+			for (size_t i = 0; i < list_.size(); i++) {
+				if (list_[i].first == name) return list_[i].second;
+			}
+			return def;
+		}
+		size_t size() const { return list_.size(); }
+		bool operator==(const Param& rhs) const { return list_ == rhs.list_; }
+		bool operator!=(const Param& rhs) const { return !operator==(rhs); }
+		// "name1=v1,name2=v2,..."
+		std::string getStr() const
+		{
+			std::string s;
+			for (size_t i = 0; i < list_.size(); i++) {
+				if (i > 0) s += ',';
+				s += list_[i].first;
+				s += '=';
+				s += std::to_string(list_[i].second);
+			}
+			return s;
+		}
+		bool setStr(const std::string& s)
+		{
+			list_.clear();
+			size_t pos = 0;
+			while (pos < s.size()) {
+				size_t end = s.find(',', pos);
+				if (end == std::string::npos) end = s.size();
+				const size_t eq = s.find('=', pos);
+				if (eq == std::string::npos || eq == pos || eq + 1 >= end) goto ERR;
+				{
+					char *endp;
+					const long v = strtol(s.c_str() + eq + 1, &endp, 10);
+					if (endp != s.c_str() + end) goto ERR;
+					list_.push_back(std::make_pair(s.substr(pos, eq - pos), int(v)));
+				}
+				if (end + 1 == s.size()) goto ERR; // trailing ','
+				pos = end + 1;
+			}
+			return true;
+		ERR:
+			list_.clear();
+			return false;
+		}
+	};
+	// candidates of each knob ; the search space is the Cartesian product of them
+	class Space {
+		typedef std::vector<std::pair<std::string, std::vector<int> > > List;
+		List list_;
+		friend class Autotuner;
+	public:
+		void add(const std::string& name, const std::vector<int>& values)
+		{
+			if (name.empty() || name.find_first_of(" ,=\n") != std::string::npos || values.empty()) XBYAK_THROW(ERR_BAD_PARAMETER)
+			list_.push_back(std::make_pair(name, values));
+		}
+		// the number of candidates
+		size_t size() const
+		{
+			if (list_.empty()) return 0;
+			size_t n = 1;
+			for (size_t i = 0; i < list_.size(); i++) n *= list_[i].second.size();
+			return n;
+		}
+		// the idx-th candidate
+		Param get(size_t idx) const
+		{
+			Param p;
+			for (size_t i = 0; i < list_.size(); i++) {
+				const std::vector<int>& v = list_[i].second;
+				p.list_.push_back(std::make_pair(list_[i].first, v[idx % v.size()]));
+				idx /= v.size();
+			}
+			return p;
+		}
+		// true if p is a candidate
+		bool contains(const Param& p) const
+		{
+			if (p.list_.size() != list_.size()) return false;
+			for (size_t i = 0; i < list_.size(); i++) {
+				if (p.list_[i].first != list_[i].first) return false;
+				const std::vector<int>& v = list_[i].second;
+				if (std::find(v.begin(), v.end(), p.list_[i].second) == v.end()) return false;
+			}
+			return true;
+		}
+	};
+	typedef std::shared_ptr<CodeGenerator> CodePtr;
+	// return the kernel for the parameters (nullptr or ERR_* to skip the candidate)
+	typedef std::function<CodePtr (const Param&)> GenFunc;
+	// run the kernel on a workload
+	typedef std::function<void (const CodeGenerator&)> WorkFunc;
+	struct Stats {
+		size_t hitNum; // the number of tune() which used the cache
+		size_t missNum; // the number of searches
+		size_t trialNum; // the number of measured candidates
+		Stats() : hitNum(0), missNum(0), trialNum(0) {}
+	};
+	explicit Autotuner(const Cpu& cpu = Cpu::getInstance())
+		: repeatN_(5)
+	{
+		char buf[128];
+		snprintf(buf, sizeof(buf), "%x.%x.%llx.%llx", uint32_t(cpu.displayFamily), uint32_t(cpu.displayModel),
+			(unsigned long long)cpu.getType().getL(), (unsigned long long)cpu.getType().getH());
+		cpuKey_ = buf;
+	}
+	// the machine type used in the cache
+	const std::string& getCpuKey() const { return cpuKey_; }
+	// each candidate runs repeatN times after a warmup and the minimum TSC is its score
+	void setRepeatN(int repeatN) { repeatN_ = repeatN > 0 ? repeatN : 1; }
+	/*
+		set the fastest parameters for name to best
+		the cached parameters are used if they exist and are in space
+		name must not be empty nor contain ' ' or '\n'
+		return false if no candidate can be generated
+	*/
+	bool tune(Param& best, const std::string& name, const Space& space, const GenFunc& gen, const WorkFunc& work)
+	{
+		return tuneSub(best, 0, name, space, gen, work);
+	}
+	/*
+		same as above and set the kernel generated with best to bestCode
+		the kernel is generated once more only if the cached parameters are used
+	*/
+	bool tune(Param& best, CodePtr& bestCode, const std::string& name, const Space& space, const GenFunc& gen, const WorkFunc& work)
+	{
+		bestCode.reset();
+		return tuneSub(best, &bestCode, name, space, gen, work);
+	}
+	// the cached parameters of name (false if not found)
+	bool getCache(Param& p, const std::string& name) const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		Cache::const_iterator i = cache_.find(name + ' ' + cpuKey_);
+		if (i == cache_.end()) return false;
+		p = i->second;
+		return true;
+	}
+	Stats getStats() const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		return stats_;
+	}
+	void clear()
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		cache_.clear();
+		stats_ = Stats();
+	}
+	/*
+		serialize the cache of all machine types to save it in a file
+		"<name> <cpuKey> <Param::getStr()>\n" for each entry
+	*/
+	std::string getStr() const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		std::vector<std::string> v;
+		for (Cache::const_iterator i = cache_.begin(); i != cache_.end(); ++i) {
+			v.push_back(i->first + ' ' + i->second.getStr() + '\n');
+		}
+		std::sort(v.begin(), v.end());
+		std::string s;
+		for (size_t i = 0; i < v.size(); i++) s += v[i];
+		return s;
+	}
+	// add the entries serialized by getStr() to the cache (return false and do not change the cache if s is invalid)
+	bool setStr(const std::string& s)
+	{
+		Cache tmp;
+		size_t pos = 0;
+		while (pos < s.size()) {
+			size_t eol = s.find('\n', pos);
+			if (eol == std::string::npos) eol = s.size();
+			const std::string line = s.substr(pos, eol - pos);
+			pos = eol + 1;
+			const size_t sp1 = line.find(' ');
+			if (sp1 == 0 || sp1 == std::string::npos) return false;
+			const size_t sp2 = line.find(' ', sp1 + 1);
+			if (sp2 == sp1 + 1 || sp2 == std::string::npos) return false;
+			Param p;
+			if (!p.setStr(line.substr(sp2 + 1))) return false;
+			tmp[line.substr(0, sp2)] = p;
+		}
+		std::lock_guard<std::mutex> lk(m_);
+		for (Cache::const_iterator i = tmp.begin(); i != tmp.end(); ++i) cache_[i->first] = i->second;
+		return true;
+	}
+private:
+	typedef std::unordered_map<std::string, Param> Cache;
+	std::string cpuKey_;
+	int repeatN_;
+	mutable std::mutex m_;
+	Cache cache_;
+	Stats stats_;
+	bool tuneSub(Param& best, CodePtr *bestCode, const std::string& name, const Space& space, const GenFunc& gen, const WorkFunc& work)
+	{
+		// getStr() and setStr() split an entry by ' ' and '\n'
+		if (name.empty() || name.find_first_of(" \n") != std::string::npos) XBYAK_THROW_RET(ERR_BAD_PARAMETER, false)
+		const std::string key = name + ' ' + cpuKey_;
+		Param cached;
+		bool isCached = false;
+		{
+			std::lock_guard<std::mutex> lk(m_);
+			Cache::const_iterator i = cache_.find(key);
+			if (i != cache_.end() && space.contains(i->second)) {
+				cached = i->second;
+				isCached = true;
+			}
+		}
+		if (isCached) {
+			CodePtr code;
+			if (bestCode) code = generate(gen, cached);
+			// search again if the cached parameters can't be generated
+			if (bestCode == 0 || code) {
+				std::lock_guard<std::mutex> lk(m_);
+				stats_.hitNum++;
+				best = cached;
+				if (bestCode) *bestCode = code;
+				return true;
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lk(m_);
+			stats_.missNum++;
+		}
+		uint64_t bestClk = 0;
+		bool found = false;
+		const size_t n = space.size();
+		for (size_t i = 0; i < n; i++) {
+			const Param p = space.get(i);
+			CodePtr code = generate(gen, p);
+			if (!code) continue;
+			work(*code); // warmup
+			uint64_t clk = 0;
+			for (int j = 0; j < repeatN_; j++) {
+				const uint64_t t = Clock::getRdtscBegin();
+				work(*code);
+				const uint64_t d = Clock::getRdtscEnd() - t;
+				if (j == 0 || d < clk) clk = d;
+			}
+			{
+				std::lock_guard<std::mutex> lk(m_);
+				stats_.trialNum++;
+			}
+			if (!found || clk < bestClk) {
+				best = p;
+				bestClk = clk;
+				found = true;
+				if (bestCode) *bestCode = code;
+			}
+		}
+		if (!found) return false;
+		std::lock_guard<std::mutex> lk(m_);
+		cache_[key] = best;
+		return true;
+	}
+	static CodePtr generate(const GenFunc& gen, const Param& p)
+	{
+		CodePtr code;
+#ifdef XBYAK_NO_EXCEPTION
+		code = gen(p);
+		if (GetError()) {
+			ClearError();
+			return CodePtr();
+		}
+#else
+		try {
+			code = gen(p);
+		} catch (Error&) {
+			return CodePtr();
+		}
+#endif
+		return code;
+	}
+};
+
+/*
+	select the best variant of a kernel for the CPU and generate only it
+	the variants are preferred in the order of add()
+
+	Dispatcher<int (*)(int)> d;
+	d.add("avx512", Cpu::tAVX512F | Cpu::tAVX512BW, []() { return std::make_shared<Avx512Code>(); });
+	d.add("avx10", Cpu::Type(), []() { return std::make_shared<Avx10Code>(); }, 2); // AVX10.2 or later
+	d.add("avx2", Cpu::tAVX2, []() { return std::make_shared<Avx2Code>(); });
+	d.add("generic", Cpu::Type(), []() { return std::make_shared<GenericCode>(); });
+	auto f = d.get(); // generate "avx512", "avx10", "avx2" or "generic"
+	d.force("avx2"); // f calls "avx2" from now on
+*/
+template<class F>
+class Dispatcher {
+public:
+	typedef std::shared_ptr<CodeGenerator> CodePtr;
+	/*
+		return the kernel (nullptr or ERR_* to use the next variant)
+		AutoGrow code is finalized by readyRE() unless the generator has called ready() or readyRE()
+	*/
+	typedef std::function<CodePtr ()> GenFunc;
+	explicit Dispatcher(const Cpu& cpu = Cpu::getInstance())
+		: cpu_(cpu)
+		, coreType_(0)
+		, cur_(0)
+		, slot_(0)
+	{
+	}
+	/*
+		add a variant which requires all features in type
+		and AVX10.avx10version or later if avx10version > 0
+	*/
+	void add(const std::string& name, const Cpu::Type& type, const GenFunc& gen, int avx10version = 0)
+	{
+		addVariant(name, type, gen, avx10version, 0);
+	}
+#if XBYAK_CPU_CACHE == 1
+	// the variant is preferred to the others if coreType is the one given by setCoreType()
+	void add(const std::string& name, const Cpu::Type& type, const GenFunc& gen, int avx10version, CoreType coreType)
+	{
+		addVariant(name, type, gen, avx10version, coreType);
+	}
+	/*
+		the type of the cores which run the kernel (e.g. the core type of the CPUs to pin the threads)
+		if get() has been called, the function switches to the best variant for coreType unless force() is used
+	*/
+	void setCoreType(CoreType coreType)
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		coreType_ = coreType;
+		if (stub_ && forced_.empty()) select();
+	}
+#endif
+	// true if name is added and the CPU has its features
+	bool isSupported(const std::string& name) const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		const Variant *v = find(name);
+		return v && isSupported(*v);
+	}
+	// the supported variants in the order of preference
+	std::vector<std::string> getSupportedNames() const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		const std::vector<Variant*> v = getCandidates();
+		std::vector<std::string> ret;
+		for (size_t i = 0; i < v.size(); i++) ret.push_back(v[i]->name);
+		return ret;
+	}
+	/*
+		use the variant name instead of the best one ("" means the best one)
+		the function returned by get() calls it from now on
+		return false (and keep the current variant) if name is not supported or can't be generated
+	*/
+	bool force(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		if (!name.empty()) {
+			const Variant *v = find(name);
+			if (v == 0 || !isSupported(*v)) return false;
+		}
+		const std::string prev = forced_;
+		forced_ = name;
+		if (stub_ == 0 || select()) return true;
+		forced_ = prev;
+		return false;
+	}
+	/*
+		the function which calls the selected variant
+		the best variant is selected and generated at the first call
+		the address does not change even if force() switches the variant
+		return nullptr if no variant can be generated
+	*/
+	F get()
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		if (stub_ == 0) {
+			if (!select()) return 0;
+			stub_ = std::make_shared<Stub>(&slot_);
+		}
+		return stub_->template getCode<F>();
+	}
+	// the name of the variant called by get() ("" if not selected)
+	std::string getName() const
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		return cur_ ? cur_->name : "";
+	}
+private:
+	struct Variant {
+		std::string name;
+		Cpu::Type type;
+		int avx10version;
+		int coreType;
+		GenFunc gen;
+		CodePtr code;
+	};
+	// jmp to *slot
+	struct Stub : CodeGenerator {
+		explicit Stub(const void *slot)
+			: CodeGenerator(64)
+		{
+#ifdef XBYAK64
+			mov(r11, size_t(slot)); // r11 is not used for arguments
+			jmp(ptr[r11]);
+#else
+			jmp(ptr[slot]);
+#endif
+			setProtectModeRE();
+		}
+	};
+	Cpu cpu_;
+	int coreType_;
+	std::vector<std::shared_ptr<Variant> > variantList_;
+	Variant *cur_;
+	std::string forced_;
+	std::shared_ptr<Stub> stub_;
+	std::atomic<const uint8_t*> slot_;
+	mutable std::mutex m_;
+	void addVariant(const std::string& name, const Cpu::Type& type, const GenFunc& gen, int avx10version, int coreType)
+	{
+		std::lock_guard<std::mutex> lk(m_);
+		if (name.empty() || find(name) || !gen) XBYAK_THROW(ERR_BAD_PARAMETER)
+		std::shared_ptr<Variant> v = std::make_shared<Variant>();
+		v->name = name;
+		v->type = type;
+		v->avx10version = avx10version;
+		v->coreType = coreType;
+		v->gen = gen;
+		variantList_.push_back(v);
+	}
+	Variant *find(const std::string& name) const
+	{
+		for (size_t i = 0; i < variantList_.size(); i++) {
+			if (variantList_[i]->name == name) return variantList_[i].get();
+		}
+		return 0;
+	}
+	bool isSupported(const Variant& v) const
+	{
+		return cpu_.has(v.type) && (v.avx10version <= 0 || cpu_.getAVX10version() >= v.avx10version);
+	}
+	// 2 : prefer coreType_, 1 : any core, 0 : prefer other cores
+	int getCoreRank(const Variant& v) const
+	{
+		if (v.coreType == 0) return 1;
+		return v.coreType == coreType_ ? 2 : 0;
+	}
+	std::vector<Variant*> getCandidates() const
+	{
+		std::vector<Variant*> ret;
+		for (int rank = 2; rank >= 0; rank--) {
+			for (size_t i = 0; i < variantList_.size(); i++) {
+				Variant *v = variantList_[i].get();
+				if (getCoreRank(*v) == rank && isSupported(*v)) ret.push_back(v);
+			}
+		}
+		return ret;
+	}
+	// generate the forced or best variant and switch to it
+	bool select()
+	{
+		std::vector<Variant*> v;
+		if (forced_.empty()) {
+			v = getCandidates();
+		} else {
+			v.push_back(find(forced_));
+		}
+		for (size_t i = 0; i < v.size(); i++) {
+			Variant& t = *v[i];
+			if (t.code == 0) t.code = generate(t.gen);
+			if (t.code == 0) continue;
+			cur_ = &t;
+			slot_.store(t.code->getCode(), std::memory_order_release);
+			return true;
+		}
+		return false;
+	}
+	static CodePtr generate(const GenFunc& gen)
+	{
+		CodePtr code;
+#ifdef XBYAK_NO_EXCEPTION
+		code = gen();
+		if (code) finalize(*code);
+		if (GetError()) {
+			ClearError();
+			return CodePtr();
+		}
+#else
+		try {
+			code = gen();
+			if (code) finalize(*code);
+		} catch (Error&) {
+			return CodePtr();
+		}
+#endif
+		return code;
+	}
+	// complete the code unless the generator has done it, not to change the protection set by the generator
+	static void finalize(CodeGenerator& code)
+	{
+		if (!code.isAutoGrow()) {
+			code.ready(); // it does not change the protection
+		} else if (!code.isCalledCalcJmpAddress()) {
+			code.readyRE();
+		}
+	}
+};
+
+/*
+	generate functions in parallel and link them into one executable region
+	ModuleBuilder mb;
+	mb.add("f", [](ModuleBuilder::Func& f) { ...; f.callFunc("g"); ...; f.ret(); });
+	mb.add("g", [](ModuleBuilder::Func& f) { ... });
+	mb.build(); // generate and link
+	auto f = mb.getFunc<int (*)()>("f");
+*/
+class ModuleBuilder {
+public:
+	// generator of a function in the module (AutoGrow mode)
+	class Func : public CodeGenerator {
+		friend class ModuleBuilder;
+		struct Ref {
+			size_t offset; // offset of rel32
+			std::string name;
+			Ref(size_t offset, const std::string& name) : offset(offset), name(name) {}
+		};
+		std::vector<Ref> refList_;
+		void putRef(int code, const std::string& name)
+		{
+			db(code);
+			refList_.push_back(Ref(getSize(), name));
+			dd(0);
+		}
+	public:
+		explicit Func(size_t maxSize = DEFAULT_MAX_CODE_SIZE) : CodeGenerator(maxSize, AutoGrow) {}
+		// call/jmp to the function name in the module
+		void callFunc(const std::string& name) { putRef(0xE8, name); }
+		void jmpFunc(const std::string& name) { putRef(0xE9, name); }
+	};
+	typedef std::function<void (Func&)> GenFunc;
+private:
+	static const size_t funcAlign = 16;
+	struct Entry {
+		std::string name;
+		GenFunc gen;
+		size_t offset;
+		size_t size;
+		Entry(const std::string& name, const GenFunc& gen) : name(name), gen(gen), offset(0), size(0) {}
+	};
+	typedef std::unordered_map<std::string, size_t> NameList;
+#ifdef XBYAK_USE_MMAP_ALLOCATOR
+	MmapAllocator defaultAllocator_;
+#else
+	Allocator defaultAllocator_;
+#endif
+	Allocator *alloc_;
+	std::vector<Entry> entryList_;
+	NameList nameList_;
+	uint8_t *top_;
+	size_t size_;
+	ModuleBuilder(const ModuleBuilder&);
+	void operator=(const ModuleBuilder&);
+	void freeRegion()
+	{
+		if (top_ == 0) return;
+		if (alloc_->useProtect()) CodeArray::protect(top_, size_, CodeArray::PROTECT_RW);
+		alloc_->free(top_);
+		top_ = 0;
+		size_ = 0;
+	}
+	// generate entryList_[i] and return error code
+	int generate(std::unique_ptr<Func>& func, size_t i) const
+	{
+		func.reset(new Func());
+		entryList_[i].gen(*func);
+#ifdef XBYAK_NO_EXCEPTION
+		const int err = GetError();
+		ClearError();
+		if (err) return err;
+#endif
+		if (func->hasUndefinedLabel()) return ERR_LABEL_IS_NOT_FOUND;
+		return ERR_NONE;
+	}
+	void link(const std::vector<std::unique_ptr<Func> >& funcList)
+	{
+		const size_t n = entryList_.size();
+		size_t size = 0;
+		for (size_t i = 0; i < n; i++) {
+			size = (size + funcAlign - 1) & ~(funcAlign - 1);
+			entryList_[i].offset = size;
+			entryList_[i].size = funcList[i]->getSize();
+			size += entryList_[i].size;
+		}
+		if (size == 0) size = 1;
+		uint8_t *top = alloc_->alloc(size);
+		if (top == 0) XBYAK_THROW(ERR_CANT_ALLOC)
+		top_ = top;
+		size_ = size;
+		memset(top_, 0xCC, size_); // int3
+		for (size_t i = 0; i < n; i++) {
+			const Func& f = *funcList[i];
+			uint8_t *p = top_ + entryList_[i].offset;
+			f.copyTo(p);
+			for (size_t j = 0; j < f.refList_.size(); j++) {
+				const Func::Ref& ref = f.refList_[j];
+				NameList::const_iterator k = nameList_.find(ref.name);
+				if (k == nameList_.end()) XBYAK_THROW(ERR_LABEL_IS_NOT_FOUND)
+				const size_t target = size_t(top_ + entryList_[k->second].offset);
+				const uint32_t disp = inner::VerifyInInt32(target - size_t(p + ref.offset + 4));
+				for (int b = 0; b < 4; b++) p[ref.offset + b] = uint8_t(disp >> (b * 8));
+			}
+		}
+		if (alloc_->useProtect() && !CodeArray::protect(top_, size_, CodeArray::PROTECT_RE)) XBYAK_THROW(ERR_CANT_PROTECT)
+	}
+public:
+	explicit ModuleBuilder(Allocator *allocator = 0)
+		: alloc_(allocator ? allocator : (Allocator*)&defaultAllocator_)
+		, top_(0)
+		, size_(0)
+	{
+	}
+	~ModuleBuilder() { freeRegion(); }
+	// add a function generated by gen
+	void add(const std::string& name, const GenFunc& gen)
+	{
+		if (nameList_.find(name) != nameList_.end()) XBYAK_THROW(ERR_LABEL_IS_REDEFINED)
+		nameList_[name] = entryList_.size();
+		entryList_.push_back(Entry(name, gen));
+	}
+	/*
+		generate all functions with threadNum threads (0 means hardware_concurrency) and link them
+		the previous module is freed
+	*/
+	void build(size_t threadNum = 0)
+	{
+		freeRegion();
+		const size_t n = entryList_.size();
+		if (threadNum == 0) threadNum = std::thread::hardware_concurrency();
+		threadNum = (std::max<size_t>)(1, (std::min)(threadNum, n));
+		std::vector<std::unique_ptr<Func> > funcList(n);
+		std::atomic<size_t> next(0);
+		std::atomic<int> err(ERR_NONE);
+		std::vector<std::exception_ptr> exceptionList(threadNum);
+		auto worker = [&](size_t t) {
+#ifdef XBYAK_NO_EXCEPTION
+			(void)t;
+#else
+			try {
+#endif
+				for (;;) {
+					const size_t i = next++;
+					if (i >= n || err != ERR_NONE) break;
+					const int e = generate(funcList[i], i);
+					if (e != ERR_NONE) err = e;
+				}
+#ifndef XBYAK_NO_EXCEPTION
+			} catch (...) {
+				exceptionList[t] = std::current_exception();
+				err = ERR_INTERNAL;
+			}
+#endif
+		};
+		std::vector<std::thread> threadList;
+		for (size_t t = 1; t < threadNum; t++) threadList.emplace_back(worker, t);
+		worker(0);
+		for (size_t t = 0; t < threadList.size(); t++) threadList[t].join();
+#ifndef XBYAK_NO_EXCEPTION
+		for (size_t t = 0; t < threadNum; t++) {
+			if (exceptionList[t]) std::rethrow_exception(exceptionList[t]);
+		}
+#endif
+		const int e = err;
+		if (e != ERR_NONE) XBYAK_THROW(e)
+		link(funcList);
+	}
+	// register the functions to the profiler
+	void setProfiler(const Profiler& prof) const
+	{
+		for (size_t i = 0; i < entryList_.size(); i++) {
+			const Entry& e = entryList_[i];
+			prof.set(e.name.c_str(), top_ + e.offset, e.size);
+		}
+	}
+	const uint8_t *getFunc(const std::string& name) const
+	{
+		NameList::const_iterator i = nameList_.find(name);
+		if (i == nameList_.end() || top_ == 0) return 0;
+		return top_ + entryList_[i->second].offset;
+	}
+	template<class F>
+	F getFunc(const std::string& name) const
+	{
+		return reinterpret_cast<F>(const_cast<uint8_t*>(getFunc(name)));
+	}
+	const uint8_t *getCode() const { return top_; }
+	size_t getSize() const { return size_; }
+	size_t getFuncNum() const { return entryList_.size(); }
+};
+
+#if XBYAK_CPU_CACHE == 1
+/*
+	work-stealing thread pool whose workers are pinned to the CPUs selected by selectCpus()
+	each worker has its own deque; the owner takes the newest task and a thief takes the oldest one
+	an idle worker steals from the others in the order of
+	SMT sibling, L2 group, L3 group, NUMA node, and the others
+	ThreadPool pool(topo);
+	pool.submit([]() { ... });
+	pool.parallelFor(n, [](size_t begin, size_t end) { ... });
+	pool.wait();
+*/
+class ThreadPool {
+public:
+	struct Stats {
+		uint64_t taskNum; // the number of tasks run by the worker
+		uint64_t stealNum; // the number of tasks stolen from other workers
+		uint64_t idleNs; // time spent sleeping without tasks in nsec
+		Stats() : taskNum(0), stealNum(0), idleNs(0) {}
+	};
+	typedef std::function<void()> Task;
+private:
+	struct Worker {
+		uint32_t cpuIdx;
+		std::vector<size_t> stealOrder; // indices of workers to steal from
+		std::mutex m;
+		std::deque<Task> q;
+		std::atomic<uint64_t> taskNum;
+		std::atomic<uint64_t> stealNum;
+		std::atomic<uint64_t> idleNs;
+		std::thread th;
+		Worker() : cpuIdx(0), taskNum(0), stealNum(0), idleNs(0) {}
+	};
+	std::vector<std::unique_ptr<Worker> > workerList_;
+	std::mutex m_;
+	std::condition_variable cv_; // to wake idle workers
+	std::condition_variable doneCv_; // to wake wait()
+	std::atomic<size_t> queuedNum_; // the number of tasks in the queues
+	size_t unfinishedNum_; // the number of submitted tasks which are not finished (guarded by m_)
+	size_t helperNum_; // the number of workers waiting in parallelFor() (guarded by m_)
+	std::atomic<size_t> next_; // for round robin
+	bool stop_;
+	std::exception_ptr exception_;
+	ThreadPool(const ThreadPool&);
+	void operator=(const ThreadPool&);
+
+	struct Local {
+		const ThreadPool *pool;
+		size_t idx;
+	};
+	// the ranges of a parallelFor() call
+	struct Group {
+		size_t remain; // the number of unfinished ranges (guarded by m_)
+		std::exception_ptr exception; // the first exception thrown by the ranges (guarded by m_)
+		Group() : remain(0) {}
+	};
+	static Local& getLocal()
+	{
+		static thread_local Local local = { 0, 0 };
+		return local;
+	}
+	// 0:SMT sibling, 1:L2, 2:L3, 3:NUMA node, 4:others
+	static int getLevel(const CpuTopology& topo, uint32_t a, uint32_t b)
+	{
+		const LogicalCpu& cpu = topo.getLogicalCpu(a);
+		const CacheType tbl[] = { L1i, L2, L3 };
+		for (int i = 0; i < 3; i++) {
+			const CpuMask& m = cpu.cache[tbl[i]].sharedCpuIndices;
+			for (CpuMask::const_iterator it = m.begin(); it != m.end(); ++it) {
+				if (*it == b) return i;
+			}
+		}
+		if (cpu.nodeIdx == topo.getLogicalCpu(b).nodeIdx) return 3;
+		return 4;
+	}
+	bool pop(Task& task, size_t idx)
+	{
+		Worker& w = *workerList_[idx];
+		std::lock_guard<std::mutex> lk(w.m);
+		if (w.q.empty()) return false;
+		task = std::move(w.q.back());
+		w.q.pop_back();
+		queuedNum_--;
+		return true;
+	}
+	bool steal(Task& task, size_t idx)
+	{
+		const std::vector<size_t>& order = workerList_[idx]->stealOrder;
+		for (size_t i = 0; i < order.size(); i++) {
+			Worker& w = *workerList_[order[i]];
+			std::lock_guard<std::mutex> lk(w.m);
+			if (w.q.empty()) continue;
+			task = std::move(w.q.front());
+			w.q.pop_front();
+			queuedNum_--;
+			return true;
+		}
+		return false;
+	}
+	void run(Task& task)
+	{
+#ifndef XBYAK_NO_EXCEPTION
+		try {
+#endif
+			task();
+#ifndef XBYAK_NO_EXCEPTION
+		} catch (...) {
+			std::lock_guard<std::mutex> lk(m_);
+			if (!exception_) exception_ = std::current_exception();
+		}
+#endif
+		task = Task();
+		std::lock_guard<std::mutex> lk(m_);
+		if (--unfinishedNum_ == 0) doneCv_.notify_all();
+	}
+	// run a task of the idx-th worker or a stolen one
+	bool runOne(Task& task, size_t idx)
+	{
+		Worker& w = *workerList_[idx];
+		if (pop(task, idx)) {
+			w.taskNum++;
+			run(task);
+			return true;
+		}
+		if (steal(task, idx)) {
+			w.taskNum++;
+			w.stealNum++;
+			run(task);
+			return true;
+		}
+		return false;
+	}
+	void loop(size_t idx)
+	{
+		Worker& w = *workerList_[idx];
+		Local& local = getLocal();
+		local.pool = this;
+		local.idx = idx;
+		CpuMask mask;
+		mask.append(w.cpuIdx);
+		setAffinity(mask);
+		Task task;
+		for (;;) {
+			if (runOne(task, idx)) continue;
+			std::unique_lock<std::mutex> lk(m_);
+			if (stop_ && queuedNum_ == 0) break;
+			if (queuedNum_ > 0) continue;
+			const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			cv_.wait(lk, [&]() { return queuedNum_ > 0 || stop_; });
+			w.idleNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+		}
+		local.pool = 0;
+	}
+	/*
+		wait until all ranges of g are finished
+		a worker runs queued tasks while waiting so that parallelFor() in a task does not deadlock
+	*/
+	void waitGroup(Group& g)
+	{
+		const int idx = getWorkerIdx();
+		std::unique_lock<std::mutex> lk(m_);
+		if (idx < 0) {
+			doneCv_.wait(lk, [&]() { return g.remain == 0; });
+			return;
+		}
+		Task task;
+		while (g.remain > 0) {
+			if (queuedNum_ == 0) {
+				helperNum_++;
+				doneCv_.wait(lk, [&]() { return g.remain == 0 || queuedNum_ > 0; });
+				helperNum_--;
+				continue;
+			}
+			lk.unlock();
+			runOne(task, size_t(idx));
+			lk.lock();
+		}
+	}
+public:
+	/*
+		create threadNum workers (0 means all CPUs)
+		if coreType is Performance or Efficient, the workers run only on the cores of the type (all cores if there are none)
+	*/
+	explicit ThreadPool(const CpuTopology& topo, size_t threadNum = 0, CoreType coreType = Unknown)
+		: queuedNum_(0)
+		, unfinishedNum_(0)
+		, helperNum_(0)
+		, next_(0)
+		, stop_(false)
+	{
+		std::vector<uint32_t> cpus = selectCpus(topo);
+		if (coreType != Unknown) {
+			std::vector<uint32_t> v;
+			for (size_t i = 0; i < cpus.size(); i++) {
+				if (topo.getLogicalCpu(cpus[i]).coreType == coreType) v.push_back(cpus[i]);
+			}
+			if (!v.empty()) cpus.swap(v);
+		}
+		if (threadNum == 0 || threadNum > cpus.size()) threadNum = cpus.size();
+		workerList_.resize(threadNum);
+		for (size_t i = 0; i < threadNum; i++) {
+			workerList_[i].reset(new Worker());
+			workerList_[i]->cpuIdx = cpus[i];
+		}
+		for (size_t i = 0; i < threadNum; i++) {
+			std::vector<std::pair<int, size_t> > v;
+			for (size_t j = 0; j < threadNum; j++) {
+				if (j == i) continue;
+				v.push_back(std::make_pair(getLevel(topo, cpus[i], cpus[j]), j));
+			}
+			std::sort(v.begin(), v.end());
+			for (size_t j = 0; j < v.size(); j++) workerList_[i]->stealOrder.push_back(v[j].second);
+		}
+		for (size_t i = 0; i < threadNum; i++) {
+			workerList_[i]->th = std::thread(&ThreadPool::loop, this, i);
+		}
+	}
+	// finish all tasks and join the workers
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_);
+			stop_ = true;
+		}
+		cv_.notify_all();
+		for (size_t i = 0; i < workerList_.size(); i++) workerList_[i]->th.join();
+	}
+	size_t getThreadNum() const { return workerList_.size(); }
+	// logical CPU of the idx-th worker
+	uint32_t getCpuIdx(size_t idx) const { return workerList_[idx]->cpuIdx; }
+	// indices of the workers which the idx-th worker steals from
+	const std::vector<size_t>& getStealOrder(size_t idx) const { return workerList_[idx]->stealOrder; }
+	// index of the worker calling this function in this pool (-1 if the caller is not a worker)
+	int getWorkerIdx() const
+	{
+		const Local& local = getLocal();
+		return local.pool == this ? int(local.idx) : -1;
+	}
+	/*
+		add a task to the queue of the calling worker, or of a worker in round robin
+		do not call wait() in a task
+	*/
+	void submit(Task task)
+	{
+		const int cur = getWorkerIdx();
+		const size_t idx = cur >= 0 ? size_t(cur) : next_++ % workerList_.size();
+		bool hasHelper;
+		{
+			// increment queuedNum_ under m_ before pushing not to miss the notification
+			std::lock_guard<std::mutex> lk(m_);
+			unfinishedNum_++;
+			queuedNum_++;
+			hasHelper = helperNum_ > 0;
+		}
+		{
+			Worker& w = *workerList_[idx];
+			std::lock_guard<std::mutex> lk(w.m);
+			w.q.push_back(std::move(task));
+		}
+		cv_.notify_one();
+		if (hasHelper) doneCv_.notify_all();
+	}
+	// wait for all submitted tasks and rethrow the first exception thrown by them
+	void wait()
+	{
+		std::unique_lock<std::mutex> lk(m_);
+		doneCv_.wait(lk, [&]() { return unfinishedNum_ == 0; });
+#ifndef XBYAK_NO_EXCEPTION
+		if (exception_) {
+			std::exception_ptr e = exception_;
+			exception_ = std::exception_ptr();
+			std::rethrow_exception(e);
+		}
+#endif
+	}
+	/*
+		call f(begin, end) for ranges which cover [0, n), wait only for them
+		and rethrow the first exception thrown by f
+		the ranges are given to the workers in the order of selectCpus() and grain is the minimum size of a range
+		it may be called in a task; then the worker runs queued tasks while waiting
+	*/
+	template<class F>
+	void parallelFor(size_t n, const F& f, size_t grain = 1)
+	{
+		if (n == 0) return;
+		if (grain == 0) grain = 1;
+		const size_t threadNum = workerList_.size();
+		// split into a few ranges per worker for load balancing
+		size_t rangeNum = (std::min)(threadNum * 4, (n + grain - 1) / grain);
+		if (rangeNum == 0) rangeNum = 1;
+		const size_t q = n / rangeNum;
+		const size_t r = n % rangeNum;
+		Group g;
+		g.remain = rangeNum;
+		size_t begin = 0;
+		for (size_t i = 0; i < rangeNum; i++) {
+			const size_t end = begin + q + (i < r ? 1 : 0);
+			submit([this, &f, &g, begin, end]() {
+#ifndef XBYAK_NO_EXCEPTION
+				try {
+#endif
+					f(begin, end);
+#ifndef XBYAK_NO_EXCEPTION
+				} catch (...) {
+					std::lock_guard<std::mutex> lk(m_);
+					if (!g.exception) g.exception = std::current_exception();
+				}
+#endif
+				// g may be destroyed as soon as remain becomes 0
+				std::lock_guard<std::mutex> lk(m_);
+				if (--g.remain == 0) doneCv_.notify_all();
+			});
+			begin = end;
+		}
+		waitGroup(g);
+#ifndef XBYAK_NO_EXCEPTION
+		if (g.exception) std::rethrow_exception(g.exception);
+#endif
+	}
+	Stats getStats(size_t idx) const
+	{
+		const Worker& w = *workerList_[idx];
+		Stats s;
+		s.taskNum = w.taskNum;
+		s.stealNum = w.stealNum;
+		s.idleNs = w.idleNs;
+		return s;
+	}
+};
+#endif // XBYAK_CPU_CACHE
+
+#if defined(XBYAK64) && defined(XBYAK_INTEL_CPU_SPECIFIC)
+/*
+	measure cycles per instance of a code snippet like uops.info
+	body(c, idx) emits the snippet into c
+	the loop repeats unroll instances of body
+	idx is 0 for all instances in Latency mode (a dependency chain)
+	and idx = 0, 1, ..., unroll - 1 in Throughput mode (use idx to select independent registers)
+	body can use all registers except rsp and getCounterReg()
+
+	Microbench mb;
+	Microbench::Result r;
+	mb.measure(r, [](CodeGenerator& c, int idx) {
+		c.vaddps(Xmm(idx), Xmm(idx), c.xmm15);
+	}, Microbench::Latency);
+	printf("%.2f +- %.2f\n", r.mean, r.stddev);
+*/
+class Microbench {
+public:
+	enum Mode {
+		Latency,
+		Throughput
+	};
+	// the vector registers are zero at the start of the loop
+	typedef std::function<void (CodeGenerator& c, int idx)> Body;
+	struct Result {
+		double mean; // cycles per instance
+		double stddev;
+		double min;
+		double inst; // retired instructions per instance (0 if not available)
+		bool byPmu; // cycles are core cycles by PerfCounter if true, otherwise TSC
+		size_t loopN; // the calibrated loop count
+		Result() : mean(0), stddev(0), min(0), inst(0), byPmu(false), loopN(0) {}
+	};
+	Microbench()
+		: unroll_(16)
+		, repeatN_(10)
+		, warmupN_(3)
+		, targetClk_(100000)
+		, cpuIdx_(-1)
+		, usePmu_(true)
+	{
+	}
+	// the loop counter (the body must not change it)
+	static const Reg64& getCounterReg()
+	{
+		static const Reg64 r(Operand::R15);
+		return r;
+	}
+	void setUnroll(int unroll) { unroll_ = unroll > 0 ? unroll : 1; }
+	// the number of measurements for the statistics
+	void setRepeatN(int repeatN) { repeatN_ = repeatN > 0 ? repeatN : 1; }
+	void setWarmupN(int warmupN) { warmupN_ = warmupN >= 0 ? warmupN : 0; }
+	// the loop count is doubled until a measurement takes targetClk TSC
+	void setTargetClk(uint64_t targetClk) { targetClk_ = targetClk; }
+	// pin the thread to cpuIdx while measuring (-1 means not pinned)
+	void setCpu(int cpuIdx) { cpuIdx_ = cpuIdx; }
+	// use TSC instead of core cycles even if the PMU is available
+	void setUsePmu(bool usePmu) { usePmu_ = usePmu; }
+	int getUnroll() const { return unroll_; }
+	// return false if the thread can't be pinned
+	bool measure(Result& r, const Body& body, Mode mode = Throughput) const
+	{
+		r = Result();
+#if XBYAK_CPU_CACHE == 1
+		CpuMask org;
+		if (cpuIdx_ >= 0) {
+			CpuMask m;
+			if (!getAffinity(org) || !m.append(uint32_t(cpuIdx_)) || !setAffinity(m)) return false;
+		}
+#else
+		if (cpuIdx_ >= 0) return false;
+#endif
+		Loop code(body, unroll_, mode);
+		Loop empty(Body(), unroll_, mode);
+		PerfCounter pc;
+		const bool byPmu = usePmu_ && pc.isAvailable(PerfCounter::Cycles);
+		const bool hasInst = pc.isAvailable(PerfCounter::Instructions);
+		// calibrate the loop count
+		size_t n = 1;
+		for (;;) {
+			const uint64_t t = Clock::getRdtscBegin();
+			code.f(n);
+			if (Clock::getRdtscEnd() - t >= targetClk_ || n >= (size_t(1) << 40)) break;
+			n *= 2;
+		}
+		for (int i = 0; i < warmupN_; i++) code.f(n);
+		// the overhead of the loop
+		double overhead = 0, overheadInst = 0;
+		for (int i = 0; i < repeatN_; i++) {
+			Sample s = run(empty, n, pc, byPmu);
+			if (i == 0 || s.cycle < overhead) overhead = s.cycle;
+			if (i == 0 || s.inst < overheadInst) overheadInst = s.inst;
+		}
+		const double div = double(n) * unroll_;
+		std::vector<double> v(repeatN_);
+		double inst = 0;
+		for (int i = 0; i < repeatN_; i++) {
+			Sample s = run(code, n, pc, byPmu);
+			v[i] = (s.cycle - overhead) / div;
+			inst += s.inst;
+		}
+		double sum = 0, min = v[0];
+		for (int i = 0; i < repeatN_; i++) {
+			sum += v[i];
+			if (v[i] < min) min = v[i];
+		}
+		r.mean = sum / repeatN_;
+		double var = 0;
+		for (int i = 0; i < repeatN_; i++) var += (v[i] - r.mean) * (v[i] - r.mean);
+		r.stddev = repeatN_ > 1 ? sqrt(var / (repeatN_ - 1)) : 0;
+		r.min = min;
+		r.inst = hasInst ? (inst / repeatN_ - overheadInst) / div : 0;
+		r.byPmu = byPmu;
+		r.loopN = n;
+#if XBYAK_CPU_CACHE == 1
+		if (cpuIdx_ >= 0) setAffinity(org);
+#endif
+		return true;
+	}
+private:
+	// void f(size_t n) ; repeat unroll instances of body n times
+	struct Loop : CodeGenerator {
+		void (*f)(size_t);
+		Loop(const Body& body, int unroll, Mode mode)
+			: CodeGenerator(4096, AutoGrow)
+		{
+#ifdef XBYAK64_WIN
+			const Reg64 regTbl[] = { rbx, rbp, rsi, rdi, r12, r13, r14, r15 };
+			const int xmmNum = 10; // xmm6, ..., xmm15
+			const Reg64& param = rcx;
+#else
+			const Reg64 regTbl[] = { rbx, rbp, r12, r13, r14, r15 };
+			const int xmmNum = 0;
+			const Reg64& param = rdi;
+#endif
+			const int regNum = int(sizeof(regTbl) / sizeof(regTbl[0]));
+			for (int i = 0; i < regNum; i++) push(regTbl[i]);
+			// 16-byte aligned after pushing regNum registers and the return address
+			const int stackSize = xmmNum * 16 + ((regNum % 2) ? 0 : 8);
+			if (stackSize) sub(rsp, stackSize);
+			for (int i = 0; i < xmmNum; i++) movdqu(ptr[rsp + i * 16], Xmm(6 + i));
+			const Reg64& counter = getCounterReg();
+			mov(counter, param);
+			// zero the vector registers so that the body does not compute on garbage (e.g. denormals)
+			const Cpu& cpu = Cpu::getInstance();
+			if (cpu.has(Cpu::tAVX512F)) {
+				for (int i = 0; i < 32; i++) vpxord(Zmm(i), Zmm(i), Zmm(i));
+			} else if (cpu.has(Cpu::tAVX)) {
+				vzeroall();
+			} else {
+				for (int i = 0; i < 16; i++) pxor(Xmm(i), Xmm(i));
+			}
+			align(16);
+			Label lp;
+			L(lp);
+			if (body) {
+				for (int i = 0; i < unroll; i++) body(*this, mode == Latency ? 0 : i);
+			}
+			dec(counter);
+			jnz(lp, T_NEAR);
+			if (cpu.has(Cpu::tAVX)) vzeroupper();
+			for (int i = 0; i < xmmNum; i++) movdqu(Xmm(6 + i), ptr[rsp + i * 16]);
+			if (stackSize) add(rsp, stackSize);
+			for (int i = regNum - 1; i >= 0; i--) pop(regTbl[i]);
+			ret();
+			ready();
+			f = getCode<void (*)(size_t)>();
+		}
+	};
+	struct Sample {
+		double cycle;
+		double inst;
+	};
+	static Sample run(const Loop& code, size_t n, const PerfCounter& pc, bool byPmu)
+	{
+		uint64_t v0[PerfCounter::TypeNum], v1[PerfCounter::TypeNum];
+		pc.read(v0);
+		const uint64_t t0 = Clock::getRdtscBegin();
+		code.f(n);
+		const uint64_t t1 = Clock::getRdtscEnd();
+		pc.read(v1);
+		Sample s;
+		s.cycle = byPmu ? double(v1[PerfCounter::Cycles] - v0[PerfCounter::Cycles]) : double(t1 - t0);
+		s.inst = double(v1[PerfCounter::Instructions] - v0[PerfCounter::Instructions]);
+		return s;
+	}
+	int unroll_;
+	int repeatN_;
+	int warmupN_;
+	uint64_t targetClk_;
+	int cpuIdx_;
+	bool usePmu_;
+};
+#endif
+
+#endif // XBYAK_UTIL_HAS_THREAD
+#endif // XBYAK_ONLY_CLASS_CPU
+
+} } // end of util
+
+#if XBYAK_CPU_CACHE == 1 && !defined(XBYAK_ONLY_CLASS_CPU) && __cplusplus >= 201103
+
+namespace std {
+
+template<>
+struct hash<Xbyak::util::CpuMask> {
+	size_t operator()(const Xbyak::util::CpuMask& m) const noexcept {
+#if XBYAK_CPUMASK_COMPACT == 1
+		return std::hash<uint64_t>{}(m.to_u64());
+#else
+		uint64_t h = 0;
+		const uint64_t *w = m.getWords();
+		for (size_t i = 0; i < m.getWordNum(); i++) {
+			h = (h ^ w[i]) * 0x100000001b3ULL;
+		}
+		return std::hash<uint64_t>{}(h);
+#endif
 	}
 };
 